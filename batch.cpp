@@ -0,0 +1,180 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include "game.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Walks the ship from wall to wall and holds fire the whole way; a steady
+// player that is easy to compare across balance changes.
+class SweepInput : public InputSource {
+private:
+    Rng rng;
+    unsigned direction;
+    int holdTicks;
+
+public:
+    explicit SweepInput(uint64_t seed) : rng(seed), direction(INPUT_RIGHT), holdTicks(0) {}
+
+    unsigned poll() {
+        if (holdTicks <= 0) {
+            direction = direction == INPUT_RIGHT ? INPUT_LEFT : INPUT_RIGHT;
+            holdTicks = 15 + rng.nextInt(25);
+        }
+        holdTicks--;
+        return direction | INPUT_SPACE | INPUT_ENTER;
+    }
+};
+
+struct GameResult {
+    long long ticks;
+    int score;
+    int wave;
+    bool gameOver;
+    GameStats stats;
+};
+
+struct BatchOptions {
+    int games;
+    int threads;
+    long long maxTicks;
+    uint64_t seed;
+    string policy;
+};
+
+// Games are independent, so each one writes only its own result slot and
+// nothing is shared while they run.
+static void playGame(const BatchOptions& options, int index, GameResult& result) {
+    uint64_t seed = options.seed + (uint64_t)index;
+    RandomInput random(seed);
+    SweepInput sweep(seed);
+    InputSource* input = options.policy == "sweep" ? (InputSource*)&sweep : (InputSource*)&random;
+
+    ResponsiveGame game(input, seed);
+    long long ticks = 0;
+    while (ticks < options.maxTicks && !game.isGameOver()) {
+        game.updateInput();
+        game.updateGame();
+        ticks++;
+    }
+
+    result.ticks = ticks;
+    result.score = game.getScore();
+    result.wave = game.getWave();
+    result.gameOver = game.isGameOver();
+    result.stats = game.getStats();
+}
+
+template <typename T>
+static T percentile(const vector<T>& sorted, int p) {
+    return sorted.empty() ? T() : sorted[min(sorted.size() - 1, sorted.size() * p / 100)];
+}
+
+static void report(const BatchOptions& options, size_t threads, const vector<GameResult>& results,
+                   double seconds) {
+    long long totalTicks = 0;
+    long long totalScore = 0;
+    long long finished = 0;
+    long long kills[ENEMY_KIND_COUNT] = { 0 };
+    long long hits[BULLET_KIND_COUNT] = { 0 };
+    vector<int> scores, waves;
+    vector<long long> survived;
+    int maxWave = 0;
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const GameResult& r = results[i];
+        totalTicks += r.ticks;
+        totalScore += r.score;
+        finished += r.gameOver;
+        scores.push_back(r.score);
+        waves.push_back(r.wave);
+        survived.push_back(r.ticks);
+        maxWave = max(maxWave, r.wave);
+        for (int k = 0; k < ENEMY_KIND_COUNT; k++) kills[k] += r.stats.kills[k];
+        for (int k = 0; k < BULLET_KIND_COUNT; k++) hits[k] += r.stats.hitsTaken[k];
+    }
+    sort(scores.begin(), scores.end());
+    sort(waves.begin(), waves.end());
+    sort(survived.begin(), survived.end());
+
+    double games = (double)results.size();
+    cout << "games=" << results.size() << " threads=" << threads << " policy=" << options.policy
+         << " seed=" << options.seed << " seconds=" << seconds
+         << " games_per_sec=" << (seconds > 0 ? games / seconds : 0)
+         << " ticks_per_sec=" << (seconds > 0 ? totalTicks / seconds : 0) << endl;
+
+    cout << "ticks_survived mean=" << totalTicks / games << " p50=" << percentile(survived, 50)
+         << " p90=" << percentile(survived, 90) << " max=" << percentile(survived, 100)
+         << " game_over=" << finished << " hit_tick_limit=" << (long long)results.size() - finished << endl;
+
+    cout << "score mean=" << totalScore / games << " p10=" << percentile(scores, 10)
+         << " p50=" << percentile(scores, 50) << " p90=" << percentile(scores, 90)
+         << " max=" << percentile(scores, 100) << endl;
+
+    cout << "waves_reached";
+    for (int w = 1; w <= maxWave; w++) {
+        long long reached = waves.end() - lower_bound(waves.begin(), waves.end(), w);
+        cout << " " << w << "=" << reached;
+    }
+    cout << endl;
+
+    cout << "kills regular=" << kills[ENEMY_REGULAR] << " boss=" << kills[ENEMY_BOSS]
+         << " giant=" << kills[ENEMY_GIANT] << endl;
+
+    // Bullets don't remember who fired them, but each kind has one source:
+    // regular enemies and bosses fire plain bullets, the giant boss fires
+    // zig-zag spreads, and only patterns use the pattern lane.
+    cout << "lives_lost enemy_bullet=" << hits[BULLET_ENEMY] << " giant_spread=" << hits[BULLET_SPREAD]
+         << " pattern=" << hits[BULLET_PATTERN] << endl;
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    options.games = 1000;
+    options.threads = 0;
+    options.maxTicks = 36000;
+    options.seed = 1;
+    options.policy = "random";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            options.games = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--max-ticks") == 0 && i + 1 < argc) {
+            options.maxTicks = max(1LL, atoll(argv[++i]));
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            options.policy = argv[++i];
+        } else {
+            cerr << "usage: galaga_batch [--games N] [--threads N] [--max-ticks N] [--seed N]"
+                 << " [--policy random|sweep]" << endl;
+            return 1;
+        }
+    }
+    if (options.policy != "random" && options.policy != "sweep") {
+        cerr << "unknown policy " << options.policy << endl;
+        return 1;
+    }
+
+    vector<GameResult> results(options.games);
+    WorkStealingPool pool(options.threads);
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < options.games; i++) {
+        GameResult* slot = &results[i];
+        const BatchOptions* opts = &options;
+        pool.submit([opts, i, slot]() { playGame(*opts, i, *slot); });
+    }
+    pool.wait();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    report(options, pool.size(), results, seconds);
+    return 0;
+}
@@ -0,0 +1,440 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include "game.h"
+#include "vector_env.h"
+#include "session_recording.h"
+
+using namespace std;
+
+// Every heap allocation in the process goes through here so that each
+// benchmark can report how many allocations one iteration costs. The
+// per-thread count tells the game thread's allocations apart from those
+// of helpers such as the session recorder's writer.
+static atomic<unsigned long long> allocationCount(0);
+static thread_local unsigned long long threadAllocationCount = 0;
+
+static void* countedAlloc(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    threadAllocationCount++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+static void countedFree(void* p) { free(p); }
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+
+typedef chrono::steady_clock Clock;
+
+struct BenchOptions {
+    int iterations;
+    uint64_t seed;
+    bool csv;
+};
+
+enum AllocationScope {
+    ALL_THREADS,    // the whole process, for benchmarks that fan out to workers
+    THIS_THREAD     // only the thread running the timed region
+};
+
+static unsigned long long allocationsSoFar(AllocationScope scope) {
+    return scope == THIS_THREAD ? threadAllocationCount : allocationCount.load(memory_order_relaxed);
+}
+
+// Collects one timing sample per iteration plus the allocation count over
+// the timed regions, then prints one result line.
+class BenchResult {
+private:
+    vector<double> samples;
+    AllocationScope scope;
+    unsigned long long allocations;
+    Clock::time_point started;
+    unsigned long long allocationsAtStart;
+
+public:
+    explicit BenchResult(int iterations, AllocationScope scope = ALL_THREADS) :
+        scope(scope), allocations(0), allocationsAtStart(0) {
+        samples.reserve(iterations);
+    }
+
+    void begin() {
+        allocationsAtStart = allocationsSoFar(scope);
+        started = Clock::now();
+    }
+
+    void end() {
+        Clock::time_point finished = Clock::now();
+        allocations += allocationsSoFar(scope) - allocationsAtStart;
+        samples.push_back(chrono::duration<double, nano>(finished - started).count());
+    }
+
+    void print(const string& scenario, const string& name, const BenchOptions& options) {
+        sort(samples.begin(), samples.end());
+        double total = 0;
+        for (size_t i = 0; i < samples.size(); i++) total += samples[i];
+
+        size_t n = samples.size();
+        double mean = n ? total / n : 0;
+        double p50 = n ? samples[n * 50 / 100] : 0;
+        double p90 = n ? samples[n * 90 / 100] : 0;
+        double p99 = n ? samples[min(n - 1, n * 99 / 100)] : 0;
+        double maxNs = n ? samples[n - 1] : 0;
+        double allocsPerIteration = n ? (double)allocations / n : 0;
+
+        if (options.csv) {
+            cout << scenario << "," << name << "," << n << "," << mean << "," << p50 << ","
+                 << p90 << "," << p99 << "," << maxNs << "," << allocsPerIteration << endl;
+        } else {
+            cout << "{\"scenario\":\"" << scenario << "\",\"benchmark\":\"" << name
+                 << "\",\"iterations\":" << n << ",\"mean_ns\":" << mean
+                 << ",\"p50_ns\":" << p50 << ",\"p90_ns\":" << p90 << ",\"p99_ns\":" << p99
+                 << ",\"max_ns\":" << maxNs << ",\"allocs_per_iter\":" << allocsPerIteration
+                 << ",\"seed\":" << options.seed << "}" << endl;
+        }
+    }
+};
+
+// A scenario is a recipe for a starting state. Benchmarks that run many
+// ticks restart from a pristine copy every `ticksPerRun` ticks so that the
+// game never drifts into game over in the middle of a measurement.
+struct Scenario {
+    string name;
+    ResponsiveGame initial;
+    int ticksPerRun;
+};
+
+static ResponsiveGame openingWave(uint64_t seed) {
+    ResponsiveGame game(nullptr, seed);
+    game.applyInput(INPUT_ENTER);
+    return game;
+}
+
+static ResponsiveGame giantBossFight(uint64_t seed) {
+    ResponsiveGame game(nullptr, seed);
+    game.startGiantBossFight(3);
+    return game;
+}
+
+static ResponsiveGame saturatedField(uint64_t seed) {
+    ResponsiveGame game(nullptr, seed);
+    game.spawnStressField(5000, 5000);
+    return game;
+}
+
+static void benchUpdateGame(Scenario& scenario, const BenchOptions& options) {
+    BenchResult result(options.iterations);
+    RandomInput input(options.seed);
+    ResponsiveGame game = scenario.initial;
+
+    for (int i = 0; i < options.iterations; i++) {
+        if (i % scenario.ticksPerRun == 0) game = scenario.initial;
+        game.applyInput(input.poll() & ~INPUT_ENTER);
+
+        result.begin();
+        game.updateGame();
+        result.end();
+    }
+    result.print(scenario.name, "update_game", options);
+}
+
+static void benchCheckCollisions(Scenario& scenario, const BenchOptions& options) {
+    BenchResult result(options.iterations);
+    RandomInput input(options.seed);
+    ResponsiveGame game = scenario.initial;
+    ResponsiveGame scratch = game;
+
+    for (int i = 0; i < options.iterations; i++) {
+        if (i % scenario.ticksPerRun == 0) game = scenario.initial;
+        game.applyInput(input.poll() & ~INPUT_ENTER);
+        game.updateEntities();
+        scratch = game;
+
+        result.begin();
+        scratch.checkCollisions();
+        result.end();
+
+        game.checkCollisions();
+    }
+    result.print(scenario.name, "check_collisions", options);
+}
+
+static void benchCreateEnemyWave(Scenario& scenario, const BenchOptions& options) {
+    BenchResult result(options.iterations);
+    ResponsiveGame game = scenario.initial;
+
+    for (int i = 0; i < options.iterations; i++) {
+        result.begin();
+        game.createEnemyWave();
+        result.end();
+    }
+    result.print(scenario.name, "create_enemy_wave", options);
+}
+
+// cast_capture is what --cast adds to the game thread per frame, counting
+// only that thread's allocations (the queue slots filling up the first
+// time around); the encoding and the writes happen on the recorder's own
+// thread. --check-allocs holds the warm capture to zero.
+static void benchRendering(Scenario& scenario, const BenchOptions& options) {
+    BenchResult compose(options.iterations);
+    BenchResult draw(options.iterations);
+    BenchResult capture(options.iterations, THIS_THREAD);
+    RandomInput input(options.seed);
+    NullStream sink;
+    ResponsiveGame game = scenario.initial;
+    const string castPath = "galaga_bench_capture.gcast";
+    SessionRecorder cast;
+    cast.open(castPath);
+
+    for (int i = 0; i < options.iterations; i++) {
+        if (i % scenario.ticksPerRun == 0) {
+            game = scenario.initial;
+            game.getRenderer().invalidate();
+        }
+        game.applyInput(input.poll() & ~INPUT_ENTER);
+        game.updateGame();
+
+        compose.begin();
+        game.composeFrame();
+        compose.end();
+
+        draw.begin();
+        game.getRenderer().draw(sink);
+        draw.end();
+
+        capture.begin();
+        cast.capture(game.getRenderer(), i * 1000 / 60);
+        capture.end();
+    }
+    cast.stop(options.iterations * 1000 / 60);
+    remove(castPath.c_str());
+
+    compose.print(scenario.name, "compose_frame", options);
+    draw.print(scenario.name, "draw", options);
+    capture.print(scenario.name, "cast_capture", options);
+}
+
+static void benchSnapshots(Scenario& scenario, const BenchOptions& options) {
+    BenchResult save(options.iterations);
+    BenchResult load(options.iterations);
+    RandomInput input(options.seed);
+    ResponsiveGame game = scenario.initial;
+    ResponsiveGame restored = scenario.initial;
+    Snapshot snapshot;
+
+    for (int i = 0; i < options.iterations; i++) {
+        if (i % scenario.ticksPerRun == 0) game = scenario.initial;
+        game.applyInput(input.poll() & ~INPUT_ENTER);
+        game.updateGame();
+
+        save.begin();
+        game.saveSnapshot(snapshot);
+        save.end();
+
+        load.begin();
+        restored.loadSnapshot(snapshot);
+        load.end();
+    }
+    save.print(scenario.name, "save_snapshot", options);
+    load.print(scenario.name, "load_snapshot", options);
+}
+
+// One batched step of `envs` games with random actions. Divide the env
+// count by the mean for env-steps per second.
+static void benchVectorEnv(const string& name, int envs, int threads, const BenchOptions& options) {
+    BenchResult result(options.iterations);
+    VectorEnv env(envs, threads);
+    vector<uint8_t> observations((size_t)envs * GALAGA_ENV_OBSERVATION_BYTES);
+    vector<int32_t> actions(envs);
+    vector<float> rewards(envs);
+    vector<uint8_t> dones(envs);
+    Rng rng(options.seed);
+
+    env.reset(options.seed, observations.data());
+    for (int i = -200; i < options.iterations; i++) {
+        for (int e = 0; e < envs; e++) actions[e] = rng.nextInt(GALAGA_ACTION_COUNT);
+
+        if (i >= 0) result.begin();
+        env.step(actions.data(), observations.data(), rewards.data(), dones.data());
+        if (i >= 0) result.end();
+    }
+    result.print(name, "env_step", options);
+}
+
+// Puts a finished game back into its scenario under a new seed. Restarts
+// reuse the stores' capacity, so they happen inside the measured tick.
+typedef void (*ScenarioRestart)(ResponsiveGame& game, uint64_t seed);
+
+static void restartOpeningWave(ResponsiveGame& game, uint64_t seed) {
+    game.restart(seed);
+}
+
+static void restartMechanics(ResponsiveGame& game, uint64_t seed) {
+    game.restart(seed);
+    game.applyInput(INPUT_MECHANICS);
+}
+
+static void restartGiantBossFight(ResponsiveGame& game, uint64_t seed) {
+    game.restart(seed);
+    game.startGiantBossFight(3);
+}
+
+static void restartSaturatedField(ResponsiveGame& game, uint64_t seed) {
+    game.restart(seed);
+    game.spawnStressField(5000, 5000);
+}
+
+// The allocation gate: after `warmup` ticks have grown every buffer to its
+// working size, a full tick (input, update, collisions, composing the frame
+// and the status lines, the diffed draw, and handing the frame to `cast`
+// if there is one) must not touch the heap on the game thread. A game that
+// ends is restarted with the next seed so the measured ticks stay live play;
+// a scenario fails if it allocated or if fewer than `ticks` ticks were live.
+// Prints one line per scenario.
+static bool checkTickAllocations(const string& name, ResponsiveGame& game, bool coop,
+                                 int warmup, int ticks, const BenchOptions& options,
+                                 ScenarioRestart restart, SessionRecorder* cast = nullptr) {
+    RandomInput input(options.seed);
+    RandomInput partner(options.seed + 1);
+    NullStream sink;
+    unsigned long long allocations = 0;
+    int firstTick = -1;
+    int liveTicks = 0;
+    int restarts = 0;
+
+    for (int i = -warmup; i < ticks; i++) {
+        unsigned long long before = threadAllocationCount;
+        if (game.isGameOver() && restart) restart(game, options.seed + ++restarts);
+        if (i >= 0 && !game.isGameOver()) liveTicks++;
+        unsigned keys = input.poll() & ~INPUT_ENTER;
+        if (coop) {
+            game.applyInputs(keys, partner.poll() & ~INPUT_ENTER);
+        } else {
+            game.applyInput(keys);
+        }
+        game.updateGame();
+        game.composeFrame();
+        game.getRenderer().draw(sink);
+        if (cast) cast->capture(game.getRenderer(), (int64_t)(i + warmup) * 1000 / 60);
+        unsigned long long allocated = threadAllocationCount - before;
+
+        if (i >= 0 && allocated) {
+            allocations += allocated;
+            if (firstTick < 0) firstTick = i;
+        }
+    }
+
+    bool ok = allocations == 0 && liveTicks >= ticks;
+    cout << "{\"check\":\"tick_allocations\",\"scenario\":\"" << name << "\",\"ticks\":" << ticks
+         << ",\"live_ticks\":" << liveTicks << ",\"restarts\":" << restarts
+         << ",\"allocations\":" << allocations << ",\"first_allocating_tick\":" << firstTick
+         << ",\"result\":\"" << (ok ? "ok" : "FAIL") << "\"}" << endl;
+    return ok;
+}
+
+static int checkAllocations(const BenchOptions& options) {
+    ResponsiveGame title(nullptr, options.seed);
+    ResponsiveGame mechanics = openingWave(options.seed);
+    mechanics.applyInput(INPUT_MECHANICS);
+    ResponsiveGame opening = openingWave(options.seed);
+    ResponsiveGame boss = giantBossFight(options.seed);
+    ResponsiveGame coop(nullptr, options.seed);
+    coop.enableCoop();
+    coop.restart(options.seed);
+    ResponsiveGame saturated = saturatedField(options.seed);
+
+    bool ok = true;
+    ok = checkTickAllocations("title_screen", title, false, 60, options.iterations, options, nullptr) && ok;
+    ok = checkTickAllocations("mechanics", mechanics, false, 60, options.iterations, options,
+                              restartMechanics) && ok;
+    ok = checkTickAllocations("opening_wave", opening, false, 600, options.iterations, options,
+                              restartOpeningWave) && ok;
+    ok = checkTickAllocations("giant_boss", boss, false, 600, options.iterations, options,
+                              restartGiantBossFight) && ok;
+    ok = checkTickAllocations("coop", coop, true, 600, options.iterations, options, restartOpeningWave) && ok;
+    ok = checkTickAllocations("saturated_10k", saturated, false, 30, min(options.iterations, 300), options,
+                              restartSaturatedField) && ok;
+
+    ResponsiveGame recorded = openingWave(options.seed);
+    const string castPath = "galaga_bench_check.gcast";
+    SessionRecorder cast;
+    if (cast.open(castPath)) {
+        ok = checkTickAllocations("cast_capture", recorded, false, 600, options.iterations, options,
+                                  restartOpeningWave, &cast) && ok;
+        cast.stop((int64_t)(600 + options.iterations) * 1000 / 60);
+        remove(castPath.c_str());
+    } else {
+        cerr << "cannot write " << castPath << endl;
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    options.iterations = 5000;
+    options.seed = 1;
+    options.csv = false;
+    bool checkAllocs = false;
+    string only;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            options.iterations = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            options.csv = true;
+        } else if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--check-allocs") == 0) {
+            checkAllocs = true;
+        } else {
+            cerr << "usage: galaga_bench [--iterations N] [--seed N] [--scenario NAME] [--csv] [--check-allocs]" << endl;
+            cerr << "scenarios: opening_wave, giant_boss, saturated_10k, vector_env_1, vector_env_64,"
+                 << " vector_env_64_mt" << endl;
+            return 1;
+        }
+    }
+
+    if (checkAllocs) return checkAllocations(options);
+
+    vector<Scenario> scenarios;
+    Scenario opening = { "opening_wave", openingWave(options.seed), 600 };
+    Scenario boss = { "giant_boss", giantBossFight(options.seed), 600 };
+    Scenario saturated = { "saturated_10k", saturatedField(options.seed), 30 };
+    scenarios.push_back(opening);
+    scenarios.push_back(boss);
+    scenarios.push_back(saturated);
+
+    if (options.csv) {
+        cout << "scenario,benchmark,iterations,mean_ns,p50_ns,p90_ns,p99_ns,max_ns,allocs_per_iter" << endl;
+    }
+
+    for (size_t s = 0; s < scenarios.size(); s++) {
+        if (!only.empty() && only != scenarios[s].name) continue;
+
+        benchUpdateGame(scenarios[s], options);
+        benchCheckCollisions(scenarios[s], options);
+        benchCreateEnemyWave(scenarios[s], options);
+        benchRendering(scenarios[s], options);
+        benchSnapshots(scenarios[s], options);
+    }
+
+    if (only.empty() || only == "vector_env_1") benchVectorEnv("vector_env_1", 1, 1, options);
+    if (only.empty() || only == "vector_env_64") benchVectorEnv("vector_env_64", 64, 1, options);
+    if (only.empty() || only == "vector_env_64_mt") benchVectorEnv("vector_env_64_mt", 64, 0, options);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+inline int popcount64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// One bit per world cell, row by row, each row a run of 64-bit words: the
+// 80-column arena is two words a row. Sprites go in as row masks shifted
+// into place, and two boards are compared with AND and popcount a word at
+// a time, a loop the compiler vectorizes.
+//
+// Rows that were written are remembered, so clear() and overlap() only
+// visit those, and a big world with a few entities stays as cheap as the
+// arena.
+class Bitboard {
+private:
+    int width, height;
+    int wordsPerRow;
+    vector<uint64_t> bits;
+    vector<uint8_t> rowUsed;
+    vector<int> usedRows;
+
+    uint64_t* row(int y) {
+        if (!rowUsed[y]) {
+            rowUsed[y] = 1;
+            usedRows.push_back(y);
+        }
+        return &bits[(size_t)y * wordsPerRow];
+    }
+
+public:
+    Bitboard(int width, int height) : width(max(width, 1)), height(max(height, 1)) {
+        wordsPerRow = (this->width + 63) / 64;
+        bits.assign((size_t)wordsPerRow * this->height, 0);
+        rowUsed.assign(this->height, 0);
+        usedRows.reserve(this->height);
+    }
+
+    void clear() {
+        for (size_t i = 0; i < usedRows.size(); i++) {
+            int y = usedRows[i];
+            memset(&bits[(size_t)y * wordsPerRow], 0, wordsPerRow * sizeof(uint64_t));
+            rowUsed[y] = 0;
+        }
+        usedRows.clear();
+    }
+
+    void set(int x, int y) {
+        if ((unsigned)x >= (unsigned)width || (unsigned)y >= (unsigned)height) return;
+        row(y)[x >> 6] |= 1ULL << (x & 63);
+    }
+
+    bool test(int x, int y) const {
+        if ((unsigned)x >= (unsigned)width || (unsigned)y >= (unsigned)height) return false;
+        return (bits[(size_t)y * wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    // ORs `mask` into row y, bit i landing on column x + i. Bits that fall
+    // off either edge are dropped.
+    void orMask(int x, int y, uint64_t mask) {
+        if ((unsigned)y >= (unsigned)height) return;
+        if (x < 0) {
+            if (x <= -64) return;
+            mask >>= -x;
+            x = 0;
+        }
+        if (x >= width) return;
+        if (width - x < 64) mask &= (1ULL << (width - x)) - 1;
+        if (!mask) return;
+
+        uint64_t* words = row(y);
+        int word = x >> 6;
+        int shift = x & 63;
+        words[word] |= mask << shift;
+        if (shift && word + 1 < wordsPerRow) words[word + 1] |= mask >> (64 - shift);
+    }
+
+    // How many cells are set on both boards, which must be the same size.
+    // Walks the rows of whichever board has fewer in use.
+    int overlap(const Bitboard& other) const {
+        const Bitboard& sparse = usedRows.size() <= other.usedRows.size() ? *this : other;
+        const Bitboard& dense = &sparse == this ? other : *this;
+        int count = 0;
+        for (size_t i = 0; i < sparse.usedRows.size(); i++) {
+            int y = sparse.usedRows[i];
+            if (!dense.rowUsed[y]) continue;
+            const uint64_t* a = &sparse.bits[(size_t)y * wordsPerRow];
+            const uint64_t* b = &dense.bits[(size_t)y * wordsPerRow];
+            for (int w = 0; w < wordsPerRow; w++) count += popcount64(a[w] & b[w]);
+        }
+        return count;
+    }
+};
+
+#endif
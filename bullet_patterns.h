@@ -0,0 +1,169 @@
+#ifndef BULLET_PATTERNS_H
+#define BULLET_PATTERNS_H
+
+#include <cstdint>
+#include <cstdlib>
+#include "bullet_store.h"
+
+using namespace std;
+
+// Angles are in binary degrees: 256 make a full turn, 0 points right and
+// 64 points straight down the screen. Velocities are in 1/256 cells per
+// tick. Everything is integer so patterns play out identically everywhere.
+const int ANGLE_STEPS = 256;
+const int ANGLE_DOWN = 64;
+
+// Terminal cells are about twice as tall as they are wide, so horizontal
+// speed is doubled to keep rings round on screen.
+const int CELL_ASPECT = 2;
+
+inline int sineQ8(int angle) {
+    static const int16_t quarter[65] = {
+        0, 6, 13, 19, 25, 31, 38, 44, 50, 56, 62, 68, 74, 80, 86, 92,
+        98, 104, 109, 115, 121, 126, 132, 137, 142, 147, 152, 157, 162, 167, 172, 177,
+        181, 185, 190, 194, 198, 202, 206, 209, 213, 216, 220, 223, 226, 229, 231, 234,
+        237, 239, 241, 243, 245, 247, 248, 250, 251, 252, 253, 254, 255, 255, 256, 256,
+        256
+    };
+    angle &= ANGLE_STEPS - 1;
+    if (angle < 64) return quarter[angle];
+    if (angle < 128) return quarter[128 - angle];
+    if (angle < 192) return -quarter[angle - 128];
+    return -quarter[256 - angle];
+}
+
+inline int cosineQ8(int angle) { return sineQ8(angle + 64); }
+
+// Closest binary-degree angle pointing from (dx, dy) = (0, 0) to the given
+// offset, found by scanning the table; only called once per aimed volley.
+inline int angleTowards(int dx, int dy) {
+    int best = ANGLE_DOWN;
+    long long bestDot = -1;
+    long long length = (long long)dx * dx + (long long)dy * dy;
+    if (length == 0) return best;
+
+    for (int angle = 0; angle < ANGLE_STEPS; angle++) {
+        long long dot = (long long)cosineQ8(angle) * dx + (long long)sineQ8(angle) * dy;
+        if (dot > bestDot) {
+            bestDot = dot;
+            best = angle;
+        }
+    }
+    return best;
+}
+
+enum PatternShape {
+    SHAPE_ROW,      // count bullets side by side, `spacing` columns apart
+    SHAPE_SPREAD,   // fan of count bullets over `arc`, centred on `angle`
+    SHAPE_RING,     // count bullets evenly around a full turn
+    SHAPE_SPIRAL,   // ring that rotates by `spin` every volley
+    SHAPE_AIMED     // fan centred on the target instead of `angle`
+};
+
+struct BulletPattern {
+    PatternShape shape;
+    int bulletKind;
+    int count;
+    int offsetX, offsetY;
+    int spacing;
+    int speed;
+    int angle;
+    int arc;
+    int spin;
+};
+
+enum PatternId {
+    PATTERN_GIANT_ZIGZAG,
+    PATTERN_GIANT_TRIPLE,
+    PATTERN_RING_16,
+    PATTERN_SPIRAL_6,
+    PATTERN_AIMED_BURST_5,
+    PATTERN_FAN_9,
+    PATTERN_COUNT
+};
+
+// The pattern table. The first two are the giant boss's original volleys:
+// five zig-zagging '*' bullets side by side and three straight shots.
+//                shape         kind            count  off    spacing speed angle       arc  spin
+const BulletPattern PATTERNS[PATTERN_COUNT] = {
+    { SHAPE_ROW,    BULLET_SPREAD,  5,     0, 3,  1,      0,    0,          0,   0  },
+    { SHAPE_ROW,    BULLET_ENEMY,   3,     0, 3,  4,      0,    0,          0,   0  },
+    { SHAPE_RING,   BULLET_PATTERN, 16,    0, 1,  0,      96,   0,          0,   0  },
+    { SHAPE_SPIRAL, BULLET_PATTERN, 6,     0, 1,  0,      128,  0,          0,   9  },
+    { SHAPE_AIMED,  BULLET_PATTERN, 5,     0, 1,  0,      160,  0,          24,  0  },
+    { SHAPE_SPREAD, BULLET_PATTERN, 9,     0, 1,  0,      112,  ANGLE_DOWN, 96,  0  }
+};
+
+// One entry of an emitter's firing schedule: fire `pattern` whenever the
+// emitter's pattern counter is a multiple of `period` and its cooldown is
+// clear, then set the cooldown.
+struct PatternStep {
+    int period;
+    int pattern;
+    int cooldown;
+};
+
+const PatternStep GIANT_BOSS_SCHEDULE[] = {
+    { 30, PATTERN_GIANT_ZIGZAG, 45 },
+    { 60, PATTERN_GIANT_TRIPLE, 30 }
+};
+const int GIANT_BOSS_SCHEDULE_LENGTH = sizeof(GIANT_BOSS_SCHEDULE) / sizeof(GIANT_BOSS_SCHEDULE[0]);
+
+// Writes one volley of a pattern straight into the bullet pool. `volley`
+// counts how many times this emitter has fired the pattern, which is what
+// turns a ring into a spiral. Returns the number of bullets that fit.
+inline int emitPattern(const BulletPattern& pattern, int originX, int originY,
+                       int targetX, int targetY, int volley, BulletStore& bullets) {
+    int x = originX + pattern.offsetX;
+    int y = originY + pattern.offsetY;
+    int emitted = 0;
+
+    if (pattern.shape == SHAPE_ROW) {
+        int first = -(pattern.count / 2) * pattern.spacing;
+        for (int i = 0; i < pattern.count; i++) {
+            emitted += bullets.spawn(pattern.bulletKind, x + first + i * pattern.spacing, y);
+        }
+        return emitted;
+    }
+
+    int start, step;
+    if (pattern.shape == SHAPE_RING || pattern.shape == SHAPE_SPIRAL) {
+        step = ANGLE_STEPS / pattern.count;
+        start = pattern.angle + (pattern.shape == SHAPE_SPIRAL ? pattern.spin * volley : 0);
+    } else {
+        int centre = pattern.shape == SHAPE_AIMED
+            ? angleTowards((targetX - x) * 256 / CELL_ASPECT, (targetY - y) * 256)
+            : pattern.angle;
+        step = pattern.count > 1 ? pattern.arc / (pattern.count - 1) : 0;
+        start = centre - step * (pattern.count - 1) / 2;
+    }
+
+    for (int i = 0; i < pattern.count; i++) {
+        int angle = start + i * step;
+        int vx = cosineQ8(angle) * pattern.speed * CELL_ASPECT / 256;
+        int vy = sineQ8(angle) * pattern.speed / 256;
+        emitted += bullets.spawn(pattern.bulletKind, x, y, vx, vy);
+    }
+    return emitted;
+}
+
+// Runs a firing schedule for one emitter. Returns true if anything fired.
+inline bool runSchedule(const PatternStep* schedule, int length, int patternCounter,
+                        int& cooldown, int x, int y, int targetX, int targetY,
+                        BulletStore& bullets) {
+    if (cooldown > 0) return false;
+
+    bool fired = false;
+    for (int i = 0; i < length; i++) {
+        const PatternStep& step = schedule[i];
+        if (patternCounter % step.period != 0) continue;
+
+        emitPattern(PATTERNS[step.pattern], x, y, targetX, targetY,
+                    patternCounter / step.period, bullets);
+        cooldown = step.cooldown;
+        fired = true;
+    }
+    return fired;
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef BULLET_STORE_H
+#define BULLET_STORE_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "parallel_update.h"
+
+using namespace std;
+
+// Rows a player shot climbs per tick. Hit tests sweep every row it crossed.
+const int PLAYER_BULLET_STEP = 2;
+
+// Ticks between two shots from one ship.
+const int PLAYER_FIRE_COOLDOWN = 8;
+
+enum BulletKind {
+    BULLET_PLAYER,
+    BULLET_ENEMY,
+    BULLET_SPREAD,
+    BULLET_PATTERN,
+    BULLET_KIND_COUNT
+};
+
+// One kind of bullet, stored as parallel arrays in a fixed-capacity pool:
+// the arrays are sized once by reserve() and spawning past capacity drops
+// the bullet instead of growing them, so firing never allocates. movePhase
+// is the old moveCounter reduced modulo the kind's movement period, which
+// is all the movement rules ever looked at. Lanes with velocity also carry
+// a per-bullet velocity and the sub-cell remainder, both in 1/256 cells.
+struct BulletLane {
+    vector<int32_t> x, y, movePhase;
+    vector<int32_t> vx, vy, fracX, fracY;
+    vector<uint8_t> active;
+    size_t count;
+    size_t capacity;
+    bool hasVelocity;
+
+    BulletLane() : count(0), capacity(0), hasVelocity(false) {}
+
+    size_t size() const { return count; }
+
+    void reserve(size_t newCapacity, bool velocity) {
+        if (newCapacity < count) newCapacity = count;
+        hasVelocity = velocity;
+        capacity = newCapacity;
+        x.resize(capacity);
+        y.resize(capacity);
+        movePhase.resize(capacity);
+        active.resize(capacity);
+        size_t velocityCapacity = velocity ? capacity : 0;
+        vx.resize(velocityCapacity);
+        vy.resize(velocityCapacity);
+        fracX.resize(velocityCapacity);
+        fracY.resize(velocityCapacity);
+    }
+
+    bool push(int px, int py, int pvx = 0, int pvy = 0) {
+        if (count == capacity) return false;
+        x[count] = px;
+        y[count] = py;
+        movePhase[count] = 0;
+        active[count] = 1;
+        if (hasVelocity) {
+            vx[count] = pvx;
+            vy[count] = pvy;
+            fracX[count] = 128;
+            fracY[count] = 128;
+        }
+        count++;
+        return true;
+    }
+
+    void clear() { count = 0; }
+
+    // Drops inactive bullets, keeping the order of the survivors.
+    void compact() {
+        size_t kept = 0;
+        if (hasVelocity) {
+            for (size_t i = 0; i < count; i++) {
+                uint8_t keep = active[i];
+                x[kept] = x[i];
+                y[kept] = y[i];
+                movePhase[kept] = movePhase[i];
+                vx[kept] = vx[i];
+                vy[kept] = vy[i];
+                fracX[kept] = fracX[i];
+                fracY[kept] = fracY[i];
+                active[kept] = 1;
+                kept += keep;
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                uint8_t keep = active[i];
+                x[kept] = x[i];
+                y[kept] = y[i];
+                movePhase[kept] = movePhase[i];
+                active[kept] = 1;
+                kept += keep;
+            }
+        }
+        count = kept;
+    }
+};
+
+// All bullets, grouped by kind. Each kind moves with one straight-line loop
+// over its arrays (no per-bullet type checks and no data-dependent
+// branches) so the compiler can vectorize it; bounds deactivation is a
+// second pass of the same shape and compaction a third.
+class BulletStore {
+private:
+    BulletLane lanes[BULLET_KIND_COUNT];
+    int width, height;
+    unsigned long long dropped;
+
+    static void movePlayer(BulletLane& lane, size_t begin, size_t end) {
+        int32_t* y = lane.y.data();
+        for (size_t i = begin; i < end; i++) {
+            y[i] -= PLAYER_BULLET_STEP;
+        }
+    }
+
+    static void moveEnemy(BulletLane& lane, size_t begin, size_t end) {
+        int32_t* y = lane.y.data();
+        int32_t* phase = lane.movePhase.data();
+        for (size_t i = begin; i < end; i++) {
+            int32_t p = phase[i] + 1;
+            p = p == 5 ? 0 : p;
+            phase[i] = p;
+            y[i] += p == 0;
+        }
+    }
+
+    static void moveSpread(BulletLane& lane, size_t begin, size_t end) {
+        int32_t* x = lane.x.data();
+        int32_t* y = lane.y.data();
+        int32_t* phase = lane.movePhase.data();
+        for (size_t i = begin; i < end; i++) {
+            int32_t p = phase[i] + 1;
+            p = p == 6 ? 0 : p;
+            phase[i] = p;
+            int32_t step = (p == 0) | (p == 3);
+            y[i] += step;
+            x[i] += step * (p < 3 ? 1 : -1);
+        }
+    }
+
+    // Pattern bullets fly along their own velocity vector.
+    static void moveVelocity(BulletLane& lane, size_t begin, size_t end) {
+        int32_t* x = lane.x.data();
+        int32_t* y = lane.y.data();
+        int32_t* fracX = lane.fracX.data();
+        int32_t* fracY = lane.fracY.data();
+        const int32_t* vx = lane.vx.data();
+        const int32_t* vy = lane.vy.data();
+        for (size_t i = begin; i < end; i++) {
+            int32_t fx = fracX[i] + vx[i];
+            int32_t fy = fracY[i] + vy[i];
+            x[i] += fx >> 8;
+            y[i] += fy >> 8;
+            fracX[i] = fx & 255;
+            fracY[i] = fy & 255;
+        }
+    }
+
+    void cullOutOfBounds(BulletLane& lane, size_t begin, size_t end) {
+        const int32_t* x = lane.x.data();
+        const int32_t* y = lane.y.data();
+        uint8_t* active = lane.active.data();
+        uint32_t w = (uint32_t)width;
+        uint32_t h = (uint32_t)height;
+        for (size_t i = begin; i < end; i++) {
+            active[i] &= (uint8_t)(((uint32_t)x[i] < w) & ((uint32_t)y[i] < h));
+        }
+    }
+
+    // Every bullet's next position and whether it is still on the field
+    // depend on that bullet alone, so any range can move on its own.
+    void moveAndCull(int kind, size_t begin, size_t end) {
+        BulletLane& lane = lanes[kind];
+        switch (kind) {
+            case BULLET_PLAYER: movePlayer(lane, begin, end); break;
+            case BULLET_ENEMY: moveEnemy(lane, begin, end); break;
+            case BULLET_SPREAD: moveSpread(lane, begin, end); break;
+            default: moveVelocity(lane, begin, end); break;
+        }
+        cullOutOfBounds(lane, begin, end);
+    }
+
+public:
+    // Pools scale with the field's height, which bounds how many bullets
+    // can be in flight: a ship fires every PLAYER_FIRE_COOLDOWN ticks and
+    // its shots climb PLAYER_BULLET_STEP rows a tick (room for two ships
+    // plus slack), and enemy shots take up to five ticks a row.
+    BulletStore(int width, int height) : width(width), height(height), dropped(0) {
+        size_t shotsInFlight = (size_t)height / (PLAYER_BULLET_STEP * PLAYER_FIRE_COOLDOWN) + 1;
+        lanes[BULLET_PLAYER].reserve(max<size_t>(64, 2 * shotsInFlight + 16), false);
+        lanes[BULLET_ENEMY].reserve(max<size_t>(1024, 5 * (size_t)height), false);
+        lanes[BULLET_SPREAD].reserve(max<size_t>(1024, 5 * (size_t)height), false);
+        lanes[BULLET_PATTERN].reserve(4096, true);
+    }
+
+    // Grows a lane's pool. This is the only place bullets allocate, so do it
+    // up front, never per tick.
+    void reserve(int kind, size_t capacity) {
+        if (capacity > lanes[kind].capacity) {
+            lanes[kind].reserve(capacity, lanes[kind].hasVelocity);
+        }
+    }
+
+    BulletLane& lane(int kind) { return lanes[kind]; }
+    const BulletLane& lane(int kind) const { return lanes[kind]; }
+
+    bool spawn(int kind, int x, int y, int vx = 0, int vy = 0) {
+        if (lanes[kind].push(x, y, vx, vy)) return true;
+        dropped++;
+        return false;
+    }
+
+    // Moves every bullet, deactivates the ones that left the field and drops
+    // everything inactive, including bullets that hit something last tick.
+    // With `parallel`, big lanes move in chunks on its threads; compaction
+    // stays a single pass so survivors keep their order.
+    void update(ParallelUpdate* parallel = nullptr) {
+        for (int kind = 0; kind < BULLET_KIND_COUNT; kind++) {
+            size_t count = lanes[kind].size();
+            if (parallel && parallel->worthSplitting(count)) {
+                parallel->forEachChunk(count, [this, kind](size_t, size_t begin, size_t end) {
+                    moveAndCull(kind, begin, end);
+                });
+            } else {
+                moveAndCull(kind, 0, count);
+            }
+            lanes[kind].compact();
+        }
+    }
+
+    void clear() {
+        for (int kind = 0; kind < BULLET_KIND_COUNT; kind++) lanes[kind].clear();
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (int kind = 0; kind < BULLET_KIND_COUNT; kind++) total += lanes[kind].size();
+        return total;
+    }
+
+    // Bullets that did not fit in their lane's pool.
+    unsigned long long getDropped() const { return dropped; }
+};
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include "game.h"
+
+#ifdef _WIN32
+#include <conio.h>
+#include <windows.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#else
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+
+using namespace std;
+
+// Everything that touches the real console lives here so that game.h stays
+// headless. Windows goes through the console API (with virtual terminal
+// processing switched on), everything else through termios and ANSI escapes.
+class Terminal {
+private:
+#ifdef _WIN32
+    HANDLE consoleHandle;
+#else
+    struct termios originalMode;
+    bool rawMode;
+#endif
+
+public:
+    explicit Terminal(const string& title) {
+#ifdef _WIN32
+        system(("title " + title).c_str());
+        system("cls");
+
+        consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        GetConsoleScreenBufferInfo(consoleHandle, &csbi);
+
+        COORD newSize;
+        newSize.X = csbi.dwSize.X;
+        newSize.Y = 1000;
+        SetConsoleScreenBufferSize(consoleHandle, newSize);
+
+        CONSOLE_CURSOR_INFO cursorInfo;
+        GetConsoleCursorInfo(consoleHandle, &cursorInfo);
+        cursorInfo.bVisible = false;
+        SetConsoleCursorInfo(consoleHandle, &cursorInfo);
+
+        system("mode con: cols=80 lines=40");
+
+        // ConsoleRenderer positions the cursor with ANSI escapes
+        DWORD mode = 0;
+        GetConsoleMode(consoleHandle, &mode);
+        SetConsoleMode(consoleHandle, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#else
+        rawMode = tcgetattr(STDIN_FILENO, &originalMode) == 0;
+        if (rawMode) {
+            struct termios raw = originalMode;
+            raw.c_lflag &= ~(ICANON | ECHO);
+            raw.c_cc[VMIN] = 0;
+            raw.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        }
+
+        cout << "\x1b]0;" << title << "\x07";
+        cout << "\x1b[?25l";
+        clearScreen();
+#endif
+    }
+
+    ~Terminal() {
+#ifndef _WIN32
+        cout << "\x1b[?25h";
+        cout.flush();
+        if (rawMode) tcsetattr(STDIN_FILENO, TCSANOW, &originalMode);
+#endif
+    }
+
+    void home() {
+#ifdef _WIN32
+        SetConsoleCursorPosition(consoleHandle, {0, 0});
+#else
+        cout << "\x1b[H";
+#endif
+    }
+
+    void clearScreen() {
+#ifdef _WIN32
+        system("cls");
+#else
+        cout << "\x1b[2J\x1b[H";
+        cout.flush();
+#endif
+    }
+
+    // Visible size in character cells. False if it can't be determined,
+    // e.g. when output is not a terminal.
+    bool getSize(int& columns, int& rows) const {
+#ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        if (!GetConsoleScreenBufferInfo(consoleHandle, &csbi)) return false;
+        columns = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+        rows = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+#else
+        struct winsize size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0) return false;
+        columns = size.ws_col;
+        rows = size.ws_row;
+#endif
+        return true;
+    }
+
+    void pause() {
+#ifdef _WIN32
+        system("pause");
+#else
+        cout << "Press any key to continue . . ." << endl;
+        if (rawMode) {
+            struct termios blocking = originalMode;
+            blocking.c_lflag &= ~(ICANON | ECHO);
+            blocking.c_cc[VMIN] = 1;
+            blocking.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSANOW, &blocking);
+        }
+        char c;
+        if (read(STDIN_FILENO, &c, 1) < 0) return;
+#endif
+    }
+};
+
+inline unsigned keyBits(char key) {
+    switch (key) {
+        case 'a': case 'A': return INPUT_LEFT;
+        case 'd': case 'D': return INPUT_RIGHT;
+        case 'w': case 'W': return INPUT_UP;
+        case 's': case 'S': return INPUT_DOWN;
+        case ' ': return INPUT_SPACE;
+        case '\r': case '\n': return INPUT_ENTER;
+        case 'q': case 'Q': return INPUT_QUIT;
+        case 'r': case 'R': return INPUT_RESTART;
+        case 'm': case 'M': return INPUT_MECHANICS;
+        case 'p': case 'P': return INPUT_PROFILER;
+    }
+    return 0;
+}
+
+// Keys held in a chunk of raw terminal input, ANSI arrow keys included.
+// Anything a terminal in raw mode sends can be fed through here, whether
+// it came from stdin or from a socket.
+inline unsigned decodeKeys(const char* bytes, size_t count) {
+    unsigned keys = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (bytes[i] == '\x1b' && i + 2 < count && bytes[i + 1] == '[') {
+            switch (bytes[i + 2]) {
+                case 'A': keys |= INPUT_UP; break;
+                case 'B': keys |= INPUT_DOWN; break;
+                case 'D': keys |= INPUT_LEFT; break;
+                case 'C': keys |= INPUT_RIGHT; break;
+            }
+            i += 2;
+        } else {
+            keys |= keyBits(bytes[i]);
+        }
+    }
+    return keys;
+}
+
+class KeyboardInput : public InputSource {
+public:
+    unsigned poll() {
+        unsigned keys = 0;
+
+#ifdef _WIN32
+        while (_kbhit()) {
+            char key = _getch();
+
+            if (key == 0 || key == -32) {
+                key = _getch();
+                switch (key) {
+                    case 72: keys |= INPUT_UP; break;
+                    case 80: keys |= INPUT_DOWN; break;
+                    case 75: keys |= INPUT_LEFT; break;
+                    case 77: keys |= INPUT_RIGHT; break;
+                }
+            } else {
+                keys |= keyBits(key);
+            }
+        }
+#else
+        char pending[64];
+        ssize_t count;
+        while ((count = read(STDIN_FILENO, pending, sizeof(pending))) > 0) {
+            keys |= decodeKeys(pending, (size_t)count);
+        }
+#endif
+
+        return keys;
+    }
+};
+
+#endif
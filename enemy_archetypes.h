@@ -0,0 +1,63 @@
+#ifndef ENEMY_ARCHETYPES_H
+#define ENEMY_ARCHETYPES_H
+
+#include "bullet_patterns.h"
+#include "sprites.h"
+
+enum EnemyKind {
+    ENEMY_REGULAR,
+    ENEMY_BOSS,
+    ENEMY_GIANT,
+    ENEMY_KIND_COUNT
+};
+
+enum EnemyMovement {
+    MOVE_MARCH,         // step sideways every movePeriod ticks, bounce off the walls
+    MOVE_MARCH_DROP,    // march, and sometimes drop a row when bouncing
+    MOVE_GIANT          // the giant boss's drifting, clamped wander
+};
+
+enum EnemyHealthBar {
+    HEALTH_NONE,
+    HEALTH_PIPS,        // one '=' per remaining hit point above the sprite
+    HEALTH_GAUGE        // wide gauge plus a "BOSS" label
+};
+
+// Everything that makes one kind of enemy different from another. The
+// store and the game instantiate their loops once per row of this table,
+// so each loop sees these values as constants and carries no per-enemy
+// type checks. A new kind is a new enum entry and a new row.
+struct EnemyArchetype {
+    int health;
+    int score;
+    EnemyMovement movement;
+    int movePeriod;                 // ticks per step
+    int fireOdds;                   // fires when rng.nextInt(fireOdds) < 2 ...
+    int fireCooldown;               // ... then waits this many ticks
+    const PatternStep* schedule;    // fires this instead when scheduleLength > 0
+    int scheduleLength;
+    SpriteId sprite;                // drawn with this, and hit wherever it is opaque
+    EnemyHealthBar healthBar;
+};
+
+//                                      hp  score  movement         period  odds  cooldown  schedule
+constexpr EnemyArchetype ENEMY_ARCHETYPES[ENEMY_KIND_COUNT] = {
+    /* ENEMY_REGULAR */ { 1,  10,   MOVE_MARCH,      3,      200,  30,       nullptr, 0,
+                          SPRITE_REGULAR, HEALTH_NONE },
+    /* ENEMY_BOSS */    { 3,  100,  MOVE_MARCH_DROP, 3,      150,  25,       nullptr, 0,
+                          SPRITE_BOSS, HEALTH_PIPS },
+    /* ENEMY_GIANT */   { 15, 300,  MOVE_GIANT,      4,      0,    0,        GIANT_BOSS_SCHEDULE,
+                          GIANT_BOSS_SCHEDULE_LENGTH, SPRITE_GIANT_BOSS, HEALTH_GAUGE }
+};
+
+constexpr int enemyStartHealth(int kind) { return ENEMY_ARCHETYPES[kind].health; }
+constexpr SpriteId enemySprite(int kind) { return ENEMY_ARCHETYPES[kind].sprite; }
+constexpr int enemyScore(int kind) { return ENEMY_ARCHETYPES[kind].score; }
+
+// Tag for walking the kinds at compile time: overloads taking
+// EnemyKindTag<Kind> recurse to EnemyKindTag<Kind + 1>, and one taking
+// EnemyKindTag<ENEMY_KIND_COUNT> ends the walk.
+template <int Kind>
+struct EnemyKindTag {};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef ENEMY_REGISTRY_H
+#define ENEMY_REGISTRY_H
+
+#include <vector>
+#include <cstdint>
+#include "enemy_archetypes.h"
+
+using namespace std;
+
+// Names one enemy for as long as it lives. `slot` indexes the store's slot
+// table and `generation` must match the slot's, so a handle to an enemy
+// that died and was compacted away stops resolving instead of silently
+// pointing at whatever reused its slot. Generation 0 is never issued.
+struct EnemyHandle {
+    uint32_t slot;
+    uint32_t generation;
+
+    bool operator==(const EnemyHandle& other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+    bool operator!=(const EnemyHandle& other) const { return !(*this == other); }
+};
+
+const EnemyHandle NO_ENEMY = { 0, 0 };
+
+enum EnemyEventType {
+    ENEMY_SPAWNED,
+    ENEMY_KILLED
+};
+
+// One spawn or death. `index` is the enemy's position in its kind's lane
+// and only holds until the lane is next compacted; `handle` keeps naming
+// the enemy until it is compacted away. (x, y) is where it happened.
+struct EnemyEvent {
+    EnemyEventType type;
+    int kind;
+    int index;
+    EnemyHandle handle;
+    int x, y;
+};
+
+// Anything outside the game that wants to hear about spawns and kills.
+class EnemyListener {
+public:
+    virtual ~EnemyListener() {}
+    virtual void onEnemyEvent(const EnemyEvent& event) = 0;
+};
+
+// Aggregates over the enemy lanes, kept current as enemies spawn and die
+// so the per-tick wave checks and the status line never scan a lane.
+// Spawns and kills are also queued as events until the owner drains them.
+class EnemyRegistry {
+private:
+    int alive[ENEMY_KIND_COUNT];
+    int aliveTotal;
+    EnemyHandle giant;
+    vector<EnemyEvent> events;
+
+    void push(EnemyEventType type, int kind, int index, EnemyHandle handle, int x, int y) {
+        EnemyEvent event = { type, kind, index, handle, x, y };
+        events.push_back(event);
+    }
+
+public:
+    EnemyRegistry() { reset(); }
+
+    void reserve(size_t n) { events.reserve(n); }
+
+    // Forgets every count and pending event without publishing anything.
+    void reset() {
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) alive[kind] = 0;
+        aliveTotal = 0;
+        giant = NO_ENEMY;
+        events.clear();
+    }
+
+    void spawned(int kind, int index, EnemyHandle handle, int x, int y) {
+        alive[kind]++;
+        aliveTotal++;
+        if (kind == ENEMY_GIANT && giant == NO_ENEMY) giant = handle;
+        push(ENEMY_SPAWNED, kind, index, handle, x, y);
+    }
+
+    // `nextGiant` is only consulted when the tracked giant boss dies, and
+    // should return the first live giant after lane index `index`, or
+    // NO_ENEMY.
+    template <typename NextGiant>
+    void killed(int kind, int index, EnemyHandle handle, int x, int y, NextGiant nextGiant) {
+        alive[kind]--;
+        aliveTotal--;
+        if (kind == ENEMY_GIANT && handle == giant) giant = nextGiant(index);
+        push(ENEMY_KILLED, kind, index, handle, x, y);
+    }
+
+    // Recounts from scratch; for after the lanes were overwritten wholesale.
+    void recount(int kind, int liveCount, EnemyHandle firstGiant) {
+        aliveTotal += liveCount - alive[kind];
+        alive[kind] = liveCount;
+        if (kind == ENEMY_GIANT) giant = firstGiant;
+    }
+
+    int aliveCount(int kind) const { return alive[kind]; }
+    int aliveCount() const { return aliveTotal; }
+
+    // The first live giant boss, or NO_ENEMY.
+    EnemyHandle giantHandle() const { return giant; }
+
+    bool bossAlive() const { return alive[ENEMY_BOSS] > 0 || alive[ENEMY_GIANT] > 0; }
+
+    const vector<EnemyEvent>& pendingEvents() const { return events; }
+    void clearEvents() { events.clear(); }
+};
+
+#endif
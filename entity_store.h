@@ -0,0 +1,508 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <vector>
+#include <cstdint>
+#include "rng.h"
+#include "bullet_store.h"
+#include "parallel_update.h"
+#include "bullet_patterns.h"
+#include "enemy_archetypes.h"
+#include "enemy_registry.h"
+
+using namespace std;
+
+// Room every lane, and the slot table, starts with: a full wave plus the
+// bosses a long wave piles up, so spawning mid-game doesn't allocate.
+const size_t ENEMY_LANE_RESERVE = 64;
+
+// One kind of enemy as parallel arrays. An enemy that dies keeps its place
+// with alive = 0 until the store compacts the lane at the start of the next
+// update; until then the batch passes mask it out arithmetically instead of
+// skipping it. `slot` is the enemy's entry in the store's slot table.
+struct EnemyLane {
+    vector<int32_t> x, y, health, direction, movePhase, shootCooldown, patternCounter;
+    vector<uint8_t> alive;
+    vector<uint32_t> slot;
+
+    size_t size() const { return x.size(); }
+
+    void push(int px, int py, int dir, int hp, uint32_t handleSlot) {
+        x.push_back(px);
+        y.push_back(py);
+        health.push_back(hp);
+        direction.push_back(dir);
+        movePhase.push_back(0);
+        shootCooldown.push_back(0);
+        patternCounter.push_back(0);
+        alive.push_back(1);
+        slot.push_back(handleSlot);
+    }
+
+    void reserve(size_t n) {
+        x.reserve(n);
+        y.reserve(n);
+        health.reserve(n);
+        direction.reserve(n);
+        movePhase.reserve(n);
+        shootCooldown.reserve(n);
+        patternCounter.reserve(n);
+        alive.reserve(n);
+        slot.reserve(n);
+    }
+
+    void resize(size_t n) {
+        x.resize(n);
+        y.resize(n);
+        health.resize(n);
+        direction.resize(n);
+        movePhase.resize(n);
+        shootCooldown.resize(n);
+        patternCounter.resize(n);
+        alive.resize(n);
+        slot.resize(n);
+    }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        health.clear();
+        direction.clear();
+        movePhase.clear();
+        shootCooldown.clear();
+        patternCounter.clear();
+        alive.clear();
+        slot.clear();
+    }
+};
+
+// Where each handle's enemy lives, as parallel arrays indexed by handle
+// slot. A free slot's `index` links to the next free slot, so released
+// slots are reused before the table grows; the table never holds more
+// slots than the most enemies ever alive at once.
+struct EnemySlotTable {
+    vector<uint32_t> generation;
+    vector<uint32_t> index;
+    vector<uint8_t> kind;
+    uint32_t freeHead;
+
+    static const uint32_t NONE = 0xFFFFFFFFu;
+
+    EnemySlotTable() : freeHead(NONE) {}
+
+    void reserve(size_t n) {
+        generation.reserve(n);
+        index.reserve(n);
+        kind.reserve(n);
+    }
+
+    size_t size() const { return generation.size(); }
+
+    uint32_t acquire(int enemyKind, uint32_t laneIndex) {
+        uint32_t s = freeHead;
+        if (s != NONE) {
+            freeHead = index[s];
+        } else {
+            s = (uint32_t)generation.size();
+            generation.push_back(1);
+            index.push_back(0);
+            kind.push_back(0);
+        }
+        index[s] = laneIndex;
+        kind[s] = (uint8_t)enemyKind;
+        return s;
+    }
+
+    // Bumping the generation on release, not on reuse, is what makes every
+    // outstanding handle to the slot stop resolving right away.
+    void release(uint32_t s) {
+        if (++generation[s] == 0) generation[s] = 1;
+        index[s] = freeHead;
+        freeHead = s;
+    }
+};
+
+class EnemyStore {
+private:
+    // How many Rng draws one chunk of a chunked update needs, and where
+    // they start in `draws`.
+    struct ChunkDraws {
+        size_t drops, shots;
+        size_t dropBegin, shotBegin;
+    };
+
+    // A shot fired during a chunked update, spawned after the last chunk.
+    struct BulletSpawn {
+        int32_t x, y;
+    };
+
+    EnemyLane lanes[ENEMY_KIND_COUNT];
+    EnemySlotTable slots;
+    EnemyRegistry registry;
+    int width, height;
+
+    vector<uint8_t> bounced;
+    vector<ChunkDraws> chunkDraws;
+    vector<uint32_t> draws;
+    vector<vector<BulletSpawn> > chunkSpawns;
+
+    EnemyHandle handleAt(int kind, size_t index) const {
+        uint32_t s = lanes[kind].slot[index];
+        EnemyHandle handle = { s, slots.generation[s] };
+        return handle;
+    }
+
+    // Drops dead enemies, keeping the order of the survivors, so collision
+    // order and Rng draws come out the same as if they had stayed in place.
+    // Their slots go back on the free list and survivors' slots are
+    // repointed at their new positions.
+    void compact(EnemyLane& lane) {
+        size_t kept = 0;
+        for (size_t i = 0; i < lane.size(); i++) {
+            uint32_t s = lane.slot[i];
+            if (!lane.alive[i]) {
+                slots.release(s);
+                continue;
+            }
+            lane.x[kept] = lane.x[i];
+            lane.y[kept] = lane.y[i];
+            lane.health[kept] = lane.health[i];
+            lane.direction[kept] = lane.direction[i];
+            lane.movePhase[kept] = lane.movePhase[i];
+            lane.shootCooldown[kept] = lane.shootCooldown[i];
+            lane.patternCounter[kept] = lane.patternCounter[i];
+            lane.alive[kept] = 1;
+            lane.slot[kept] = s;
+            slots.index[s] = (uint32_t)kept;
+            kept++;
+        }
+        lane.resize(kept);
+    }
+
+    // Every marching kind steps once per movePeriod ticks and bounces off
+    // the walls. Which ones bounced is left in `bounced`, which the caller
+    // has sized to the lane, for kinds that may drop a row when they turn.
+    template <int Kind>
+    void moveMarching(EnemyLane& lane, size_t begin, size_t end) {
+        const int32_t period = ENEMY_ARCHETYPES[Kind].movePeriod;
+        uint8_t* bounce = bounced.data();
+        int32_t* x = lane.x.data();
+        int32_t* dir = lane.direction.data();
+        int32_t* phase = lane.movePhase.data();
+        const uint8_t* alive = lane.alive.data();
+        int32_t leftWall = 1;
+        int32_t rightWall = width - 2;
+        for (size_t i = begin; i < end; i++) {
+            int32_t a = alive[i];
+            int32_t p = phase[i] + a;
+            p = p == period ? 0 : p;
+            phase[i] = p;
+            int32_t step = a & (p == 0);
+            int32_t nx = x[i] + step * dir[i];
+            int32_t turn = step & ((nx <= leftWall) | (nx >= rightWall));
+            x[i] = nx;
+            dir[i] *= 1 - 2 * turn;
+            bounce[i] = (uint8_t)turn;
+        }
+    }
+
+    void dropOnBounce(EnemyLane& lane, Rng& rng) {
+        for (size_t i = 0; i < lane.size(); i++) {
+            if (bounced[i] && rng.nextInt(2) == 0) lane.y[i]++;
+        }
+    }
+
+    static void tickCooldowns(EnemyLane& lane, size_t begin, size_t end) {
+        int32_t* cooldown = lane.shootCooldown.data();
+        const uint8_t* alive = lane.alive.data();
+        for (size_t i = begin; i < end; i++) {
+            cooldown[i] -= alive[i] & (cooldown[i] > 0);
+        }
+    }
+
+    // At most one giant boss is ever alive, so it keeps the scalar rules.
+    template <int Kind>
+    void moveGiants(EnemyLane& lane, Rng& rng) {
+        const int32_t period = ENEMY_ARCHETYPES[Kind].movePeriod;
+        for (size_t i = 0; i < lane.size(); i++) {
+            if (!lane.alive[i]) continue;
+
+            lane.movePhase[i] = (lane.movePhase[i] + 1) % period;
+            lane.patternCounter[i]++;
+            if (lane.movePhase[i] != 0) continue;
+
+            lane.x[i] += lane.direction[i];
+
+            if (lane.patternCounter[i] > 60) {
+                if (rng.nextInt(100) < 5) {
+                    lane.direction[i] = -lane.direction[i];
+                }
+                if (lane.patternCounter[i] > 120) {
+                    lane.patternCounter[i] = 0;
+                    lane.y[i] += 1;
+                }
+            }
+
+            if (lane.x[i] <= 5) lane.x[i] = 5;
+            if (lane.x[i] >= width - 6) lane.x[i] = width - 6;
+            if (lane.y[i] >= height - 8) lane.y[i] = height - 8;
+        }
+    }
+
+    // Firing draws from the game's Rng, so it is a sequential pass here
+    // (updateChunked splits it another way); it only touches enemies whose
+    // cooldown has run out.
+    template <int Kind>
+    static void shootSingle(EnemyLane& lane, Rng& rng, BulletStore& bullets) {
+        const int odds = ENEMY_ARCHETYPES[Kind].fireOdds;
+        const int cooldown = ENEMY_ARCHETYPES[Kind].fireCooldown;
+        for (size_t i = 0; i < lane.size(); i++) {
+            if (!lane.alive[i] || lane.shootCooldown[i] > 0) continue;
+            if (rng.nextInt(odds) < 2) {
+                bullets.spawn(BULLET_ENEMY, lane.x[i], lane.y[i] + 1);
+                lane.shootCooldown[i] = cooldown;
+            }
+        }
+    }
+
+    template <int Kind>
+    static void shootScheduled(EnemyLane& lane, BulletStore& bullets, int targetX, int targetY) {
+        for (size_t i = 0; i < lane.size(); i++) {
+            if (!lane.alive[i]) continue;
+            runSchedule(ENEMY_ARCHETYPES[Kind].schedule, ENEMY_ARCHETYPES[Kind].scheduleLength,
+                        lane.patternCounter[i], lane.shootCooldown[i], lane.x[i], lane.y[i],
+                        targetX, targetY, bullets);
+        }
+    }
+
+    // updateKind for a marching kind that fires single shots, in chunks.
+    // Which enemies draw from the Rng follows from the movement and
+    // cooldown passes alone, so those run first and count each chunk's
+    // draws. The draws are then taken in one sequential run, in the order
+    // the single pass takes them (every drop, then every shot), and dealt
+    // out by prefix sum. Shots go to per-chunk buffers that are spawned in
+    // chunk order, which is lane order.
+    template <int Kind>
+    void updateChunked(Rng& rng, BulletStore& bullets, ParallelUpdate& parallel) {
+        const bool drops = ENEMY_ARCHETYPES[Kind].movement == MOVE_MARCH_DROP;
+        const int odds = ENEMY_ARCHETYPES[Kind].fireOdds;
+        const int cooldown = ENEMY_ARCHETYPES[Kind].fireCooldown;
+        EnemyLane& lane = lanes[Kind];
+        size_t count = lane.size();
+        size_t chunks = parallel.chunkCount(count);
+        bounced.resize(count);
+        chunkDraws.resize(chunks);
+        if (chunkSpawns.size() < chunks) chunkSpawns.resize(chunks);
+
+        parallel.forEachChunk(count, [&](size_t c, size_t begin, size_t end) {
+            moveMarching<Kind>(lane, begin, end);
+            tickCooldowns(lane, begin, end);
+            size_t dropCount = 0, shotCount = 0;
+            for (size_t i = begin; i < end; i++) {
+                dropCount += bounced[i];
+                shotCount += lane.alive[i] & (lane.shootCooldown[i] <= 0);
+            }
+            chunkDraws[c].drops = drops ? dropCount : 0;
+            chunkDraws[c].shots = shotCount;
+        });
+
+        size_t total = 0;
+        for (size_t c = 0; c < chunks; c++) {
+            chunkDraws[c].dropBegin = total;
+            total += chunkDraws[c].drops;
+        }
+        for (size_t c = 0; c < chunks; c++) {
+            chunkDraws[c].shotBegin = total;
+            total += chunkDraws[c].shots;
+        }
+        draws.resize(total);
+        for (size_t i = 0; i < total; i++) draws[i] = rng.next();
+
+        parallel.forEachChunk(count, [&](size_t c, size_t begin, size_t end) {
+            const uint32_t* drop = draws.data() + chunkDraws[c].dropBegin;
+            if (drops) {
+                for (size_t i = begin; i < end; i++) {
+                    if (bounced[i] && Rng::boundedInt(*drop++, 2) == 0) lane.y[i]++;
+                }
+            }
+
+            const uint32_t* shot = draws.data() + chunkDraws[c].shotBegin;
+            vector<BulletSpawn>& spawns = chunkSpawns[c];
+            spawns.clear();
+            for (size_t i = begin; i < end; i++) {
+                if (!lane.alive[i] || lane.shootCooldown[i] > 0) continue;
+                if (Rng::boundedInt(*shot++, odds) < 2) {
+                    BulletSpawn spawn = { lane.x[i], lane.y[i] + 1 };
+                    spawns.push_back(spawn);
+                    lane.shootCooldown[i] = cooldown;
+                }
+            }
+        });
+
+        for (size_t c = 0; c < chunks; c++) {
+            const vector<BulletSpawn>& spawns = chunkSpawns[c];
+            for (size_t s = 0; s < spawns.size(); s++) bullets.spawn(BULLET_ENEMY, spawns[s].x, spawns[s].y);
+        }
+    }
+
+    // Movement, cooldowns and firing for one kind. The archetype is a
+    // compile-time constant here, so the untaken branches disappear.
+    template <int Kind>
+    void updateKind(Rng& rng, BulletStore& bullets, int targetX, int targetY, ParallelUpdate* parallel) {
+        EnemyLane& lane = lanes[Kind];
+        if (ENEMY_ARCHETYPES[Kind].movement != MOVE_GIANT && ENEMY_ARCHETYPES[Kind].scheduleLength == 0 &&
+            parallel && parallel->worthSplitting(lane.size())) {
+            updateChunked<Kind>(rng, bullets, *parallel);
+            return;
+        }
+
+        if (ENEMY_ARCHETYPES[Kind].movement == MOVE_GIANT) {
+            moveGiants<Kind>(lane, rng);
+        } else {
+            bounced.resize(lane.size());
+            moveMarching<Kind>(lane, 0, lane.size());
+            if (ENEMY_ARCHETYPES[Kind].movement == MOVE_MARCH_DROP) dropOnBounce(lane, rng);
+        }
+
+        tickCooldowns(lane, 0, lane.size());
+
+        if (ENEMY_ARCHETYPES[Kind].scheduleLength > 0) {
+            shootScheduled<Kind>(lane, bullets, targetX, targetY);
+        } else {
+            shootSingle<Kind>(lane, rng, bullets);
+        }
+    }
+
+    template <int Kind>
+    void updateKinds(EnemyKindTag<Kind>, Rng& rng, BulletStore& bullets, int targetX, int targetY,
+                     ParallelUpdate* parallel) {
+        updateKind<Kind>(rng, bullets, targetX, targetY, parallel);
+        updateKinds(EnemyKindTag<Kind + 1>(), rng, bullets, targetX, targetY, parallel);
+    }
+
+    void updateKinds(EnemyKindTag<ENEMY_KIND_COUNT>, Rng&, BulletStore&, int, int, ParallelUpdate*) {}
+
+public:
+    EnemyStore(int width, int height) : width(width), height(height) {
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) lanes[kind].reserve(ENEMY_LANE_RESERVE);
+        slots.reserve(ENEMY_KIND_COUNT * ENEMY_LANE_RESERVE);
+        bounced.reserve(ENEMY_LANE_RESERVE);
+        registry.reserve(ENEMY_LANE_RESERVE);
+    }
+
+    // Makes room for `count` enemies of any mix of kinds, so a field spawned
+    // all at once doesn't grow its lanes one doubling at a time.
+    void reserve(size_t count) {
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) lanes[kind].reserve(count);
+        slots.reserve(count);
+        bounced.reserve(count);
+        registry.reserve(count);
+    }
+
+    EnemyLane& lane(int kind) { return lanes[kind]; }
+    const EnemyLane& lane(int kind) const { return lanes[kind]; }
+
+    EnemySlotTable& slotTable() { return slots; }
+    const EnemySlotTable& slotTable() const { return slots; }
+
+    const EnemyRegistry& getRegistry() const { return registry; }
+
+    EnemyHandle spawn(int kind, int x, int y, int direction = 1) {
+        EnemyLane& l = lanes[kind];
+        uint32_t s = slots.acquire(kind, (uint32_t)l.size());
+        l.push(x, y, direction, enemyStartHealth(kind), s);
+        EnemyHandle handle = { s, slots.generation[s] };
+        registry.spawned(kind, (int)l.size() - 1, handle, x, y);
+        return handle;
+    }
+
+    // Finds a live enemy by handle. False once it has died, even before its
+    // slot is released.
+    bool resolve(EnemyHandle handle, int& kind, size_t& index) const {
+        if (handle.slot >= slots.size() || slots.generation[handle.slot] != handle.generation) {
+            return false;
+        }
+        kind = slots.kind[handle.slot];
+        index = slots.index[handle.slot];
+        return lanes[kind].alive[index] != 0;
+    }
+
+    // One hit on a live enemy. Returns true if it died.
+    bool damage(int kind, size_t index) {
+        EnemyLane& l = lanes[kind];
+        if (--l.health[index] > 0) return false;
+        l.alive[index] = 0;
+        registry.killed(kind, (int)index, handleAt(kind, index), l.x[index], l.y[index],
+                        [this](int after) { return firstAlive(ENEMY_GIANT, after + 1); });
+        return true;
+    }
+
+    // Every enemy goes, and so does every handle to one.
+    void clear() {
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) {
+            EnemyLane& l = lanes[kind];
+            for (size_t i = 0; i < l.size(); i++) slots.release(l.slot[i]);
+            l.clear();
+        }
+        registry.reset();
+    }
+
+    // Rebuilds the registry after the lanes were restored wholesale, as a
+    // snapshot load does. Pending events are dropped.
+    void recount() {
+        registry.reset();
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) {
+            const EnemyLane& l = lanes[kind];
+            int alive = 0;
+            for (size_t i = 0; i < l.size(); i++) alive += l.alive[i];
+            registry.recount(kind, alive, kind == ENEMY_GIANT ? firstAlive(kind, 0) : NO_ENEMY);
+        }
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) total += lanes[kind].size();
+        return total;
+    }
+
+    // The first live enemy of `kind` at or after lane index `from`.
+    EnemyHandle firstAlive(int kind, size_t from) const {
+        const EnemyLane& l = lanes[kind];
+        for (size_t i = from; i < l.size(); i++) {
+            if (l.alive[i]) return handleAt(kind, i);
+        }
+        return NO_ENEMY;
+    }
+
+    int aliveCount(int kind) const { return registry.aliveCount(kind); }
+    int aliveCount() const { return registry.aliveCount(); }
+
+    // Every regular enemy of a wave that has spawned is dead.
+    bool waveCleared() const { return registry.aliveCount(ENEMY_REGULAR) == 0 && size() > 0; }
+
+    // Health of the first live giant boss, or -1 if there is none.
+    int giantHealth() const {
+        int kind;
+        size_t index;
+        if (!resolve(registry.giantHandle(), kind, index)) return -1;
+        return lanes[kind].health[index];
+    }
+
+    const vector<EnemyEvent>& pendingEvents() const { return registry.pendingEvents(); }
+    void clearEvents() { registry.clearEvents(); }
+
+    // Movement, cooldowns and firing for every live enemy, one kind at a
+    // time in enum order (the wave first, bosses after) so Rng draws keep
+    // the same order. (targetX, targetY) is what aimed patterns aim at.
+    // Enemies that died since the last update are compacted away first, so
+    // the passes only walk live ones. With `parallel`, big lanes update in
+    // chunks on its threads with the same outcome.
+    void update(Rng& rng, BulletStore& bullets, int targetX, int targetY, ParallelUpdate* parallel = nullptr) {
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) {
+            if ((size_t)registry.aliveCount(kind) != lanes[kind].size()) compact(lanes[kind]);
+        }
+        updateKinds(EnemyKindTag<0>(), rng, bullets, targetX, targetY, parallel);
+    }
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "game.h"
+#include "input_thread.h"
+
+using namespace std;
+
+// One composed frame, frozen: field rows, footer lines, and when the
+// inputs it reflects were read.
+struct FrameImage {
+    static const int MAX_INPUTS = 64;
+
+    vector<string> rows;
+    vector<string> lines;
+    int64_t inputStamps[MAX_INPUTS];
+    int inputCount;
+
+    FrameImage() : rows(HEIGHT, string(WIDTH, ' ')), inputCount(0) {}
+};
+
+// Lock-free triple buffer: the writer always has a slot to fill, the
+// reader always has a complete slot to show, and the third slot holds the
+// newest published frame. Publishing and acquiring are one atomic exchange
+// each, so neither side ever waits for the other.
+template <typename T>
+class TripleBuffer {
+private:
+    static const int FRESH = 4;     // set on `middle` until the reader takes it
+
+    T slots[3];
+    atomic<int> middle;
+    int back;   // writer's slot
+    int front;  // reader's slot
+
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+
+    T& writeSlot() { return slots[back]; }
+    const T& readSlot() const { return slots[front]; }
+
+    // Makes the write slot the newest frame. Returns true if that replaced
+    // a frame the reader never saw; the write slot is then that frame.
+    bool publish() {
+        int previous = middle.exchange(back | FRESH, memory_order_acq_rel);
+        back = previous & 3;
+        return (previous & FRESH) != 0;
+    }
+
+    // Takes the newest frame if there is one the reader hasn't had yet.
+    bool acquire() {
+        if (!(middle.load(memory_order_acquire) & FRESH)) return false;
+        int previous = middle.exchange(front, memory_order_acq_rel);
+        front = previous & 3;
+        return true;
+    }
+};
+
+struct RenderStats {
+    long long published;
+    long long presented;
+    long long dropped;      // overwritten before the render thread got to them
+    long long duplicated;   // render deadlines with nothing new to show
+    double meanDrawMs;
+    double maxDrawMs;
+
+    RenderStats() : published(0), presented(0), dropped(0), duplicated(0), meanDrawMs(0), maxDrawMs(0) {}
+};
+
+// Writes frames to the terminal on its own thread, at most renderRate
+// times a second, always the newest complete one. The game thread composes
+// into beginFrame(), calls publishFrame(), and goes straight back to
+// simulating; a slow terminal only ever delays the render thread.
+class RenderThread {
+private:
+    typedef chrono::steady_clock Clock;
+
+    ostream& out;
+    Clock::duration interval;
+    TripleBuffer<FrameImage> frames;
+    ConsoleRenderer presenter;
+    atomic<bool> running;
+    thread worker;
+
+    // Owned by the game thread.
+    long long published;
+    long long dropped;
+    bool carryInputs;
+
+    // Owned by the render thread until stop() joins it.
+    long long presented;
+    long long duplicated;
+    double drawSumMs;
+    double drawMaxMs;
+    LatencyHistogram latency;
+
+    void present() {
+        const FrameImage& frame = frames.readSlot();
+        Clock::time_point start = Clock::now();
+        presenter.loadFrame(frame.rows, frame.lines);
+        presenter.draw(out);
+
+        int64_t shown = ThreadedKeyboardInput::nowNs();
+        for (int i = 0; i < frame.inputCount; i++) latency.add(shown - frame.inputStamps[i]);
+
+        double drawMs = chrono::duration<double, milli>(Clock::now() - start).count();
+        drawSumMs += drawMs;
+        if (drawMs > drawMaxMs) drawMaxMs = drawMs;
+        presented++;
+    }
+
+    void renderLoop() {
+        Clock::time_point next = Clock::now();
+        while (running.load(memory_order_acquire)) {
+            if (frames.acquire()) {
+                present();
+            } else if (presented > 0) {
+                duplicated++;
+            }
+            next += interval;
+            Clock::time_point now = Clock::now();
+            if (next < now) next = now;
+            this_thread::sleep_until(next);
+        }
+        // Whatever was published last still deserves to be seen.
+        if (frames.acquire()) present();
+    }
+
+public:
+    RenderThread(ostream& out, double renderRate) :
+        out(out), interval(chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / renderRate))),
+        running(true), published(0), dropped(0), carryInputs(false),
+        presented(0), duplicated(0), drawSumMs(0), drawMaxMs(0) {
+        worker = thread(&RenderThread::renderLoop, this);
+    }
+
+    ~RenderThread() { stop(); }
+
+    // The slot to compose the next frame into. Input stamps of a frame that
+    // was dropped are kept, so their latency is measured on the frame that
+    // finally shows them.
+    FrameImage& beginFrame() {
+        FrameImage& frame = frames.writeSlot();
+        if (!carryInputs) frame.inputCount = 0;
+        return frame;
+    }
+
+    void publishFrame() {
+        published++;
+        carryInputs = frames.publish();
+        if (carryInputs) dropped++;
+    }
+
+    // Presents the last published frame, then joins the render thread.
+    void stop() {
+        running.store(false, memory_order_release);
+        if (worker.joinable()) worker.join();
+    }
+
+    // Only meaningful after stop().
+    RenderStats getStats() const {
+        RenderStats stats;
+        stats.published = published;
+        stats.presented = presented;
+        stats.dropped = dropped;
+        stats.duplicated = duplicated;
+        stats.meanDrawMs = presented ? drawSumMs / presented : 0;
+        stats.maxDrawMs = drawMaxMs;
+        return stats;
+    }
+
+    const LatencyHistogram& getLatency() const { return latency; }
+    const ConsoleRenderer& getPresenter() const { return presenter; }
+};
+
+#endif
@@ -1,783 +1,834 @@
 #include <iostream>
-#include <vector>
 #include <chrono>
-#include <thread>
-#include <conio.h>
-#include <windows.h>
-#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include "game.h"
+#include "console.h"
+#include "input_thread.h"
+#include "frame_pipeline.h"
+#include "game_loop.h"
+#include "replay.h"
+#include "lockstep.h"
+#include "session_recording.h"
 
 using namespace std;
 
-const int WIDTH = 80;
-const int HEIGHT = 24;
-const int PLAYER_POS = HEIGHT - 2;
-
-class ConsoleRenderer {
-private:
-    vector<string> buffer;
-    HANDLE consoleHandle;
-    
-public:
-    ConsoleRenderer() {
-        buffer.resize(HEIGHT, string(WIDTH, ' '));
-        consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-        
-        CONSOLE_CURSOR_INFO cursorInfo;
-        GetConsoleCursorInfo(consoleHandle, &cursorInfo);
-        cursorInfo.bVisible = false;
-        SetConsoleCursorInfo(consoleHandle, &cursorInfo);
-        
-        system("mode con: cols=80 lines=40");
-    }
-    
-    void clear() {
-        for (int y = 0; y < HEIGHT; y++) {
-            for (int x = 0; x < WIDTH; x++) {
-                buffer[y][x] = ' ';
-            }
-        }
+// Rows under and around the viewport: two borders, status, controls,
+// game over and hint lines.
+const int VIEW_FOOTER_ROWS = 6;
+
+// One tick and one frame with every phase timed. The timers cost next to
+// nothing while the profiler is disabled.
+void profiledTick(ResponsiveGame& game, FrameProfiler& profiler) {
+    {
+        ScopedPhase phase(&profiler, PHASE_INPUT);
+        game.updateInput();
     }
-    
-    void setChar(int x, int y, char c) {
-        if (x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT) {
-            buffer[y][x] = c;
-        }
+    {
+        ScopedPhase phase(&profiler, PHASE_UPDATE);
+        game.updateGame();
     }
-    
-    void draw() {
-        SetConsoleCursorPosition(consoleHandle, {0, 0});
-        
-        cout << string(WIDTH, '=') << endl;
-        
-        for (int y = 0; y < HEIGHT; y++) {
-            cout << buffer[y] << endl;
-        }
-        
-        cout << string(WIDTH, '=') << endl;
-        
-        cout.flush();
+}
+
+void profiledRender(ResponsiveGame& game, FrameProfiler& profiler, ostream& out) {
+    {
+        ScopedPhase phase(&profiler, PHASE_COMPOSE);
+        game.composeFrame();
     }
-};
+    {
+        ScopedPhase phase(&profiler, PHASE_DRAW);
+        game.getRenderer().draw(out);
+    }
+    profiler.endFrame();
+}
 
-struct Bullet {
-    int x, y;
-    bool active;
-    bool playerBullet;
-    int moveCounter;
-    bool bossSpreadBullet;
-    
-    Bullet(int x, int y, bool isPlayer, bool spread = false) : 
-        x(x), y(y), active(true), playerBullet(isPlayer), moveCounter(0), bossSpreadBullet(spread) {}
-    
-    void update() {
-        if (playerBullet) {
-            y -= 2;
-        } else {
-            if (bossSpreadBullet) {
-                moveCounter++;
-                if (moveCounter % 3 == 0) {
-                    y += 1;
-                    x += (moveCounter % 6 < 3) ? 1 : -1;
-                }
-            } else {
-                moveCounter++;
-                if (moveCounter % 5 == 0) {
-                    y += 1;
-                }
-            }
-        }
-        
-        if (y < 0 || y >= HEIGHT || x < 0 || x >= WIDTH) active = false;
+// Composes the current state and hands it to the render thread. In this
+// mode the DRAW phase times only the hand-off; the terminal write happens
+// on the render thread.
+void publishFrame(ResponsiveGame& game, FrameProfiler& profiler, ThreadedKeyboardInput& keyboard,
+                  RenderThread& renderThread, SessionRecorder* cast = nullptr) {
+    FrameImage& frame = renderThread.beginFrame();
+    {
+        ScopedPhase phase(&profiler, PHASE_COMPOSE);
+        game.composeFrame();
     }
-};
+    if (cast) cast->capture(game.getRenderer());
+    {
+        ScopedPhase phase(&profiler, PHASE_DRAW);
+        game.getRenderer().saveFrame(frame.rows, frame.lines);
+        frame.inputCount += keyboard.takeConsumed(frame.inputStamps + frame.inputCount,
+                                                  FrameImage::MAX_INPUTS - frame.inputCount);
+        renderThread.publishFrame();
+    }
+    profiler.endFrame();
+}
 
-struct Enemy {
-    int x, y;
-    bool alive;
-    bool isBoss;
-    bool isGiantBoss;
-    int health;
-    int direction;
-    int moveCounter;
-    int shootCooldown;
-    int patternCounter;
-    
-    Enemy(int x, int y, bool boss = false, bool giant = false) : 
-        x(x), y(y), alive(true), isBoss(boss), isGiantBoss(giant), 
-        direction(1), moveCounter(0), shootCooldown(0), patternCounter(0) {
-        if (isGiantBoss) {
-            health = 15;
-        } else if (isBoss) {
-            health = 3;
-        } else {
-            health = 1;
-        }
+bool writeProfile(const FrameProfiler& profiler, const string& path) {
+    if (path.empty()) return true;
+    if (!profiler.write(path)) {
+        cerr << "cannot write " << path << endl;
+        return false;
     }
-    
-    void update() {
-        moveCounter++;
-        patternCounter++;
-        
-        if (isGiantBoss) {
-            if (moveCounter % 4 == 0) {
-                x += direction;
-                
-                if (patternCounter > 60) {
-                    if (rand() % 100 < 5) {
-                        direction = -direction;
-                    }
-                    if (patternCounter > 120) {
-                        patternCounter = 0;
-                        y += 1;
-                    }
-                }
-                
-                if (x <= 5) x = 5;
-                if (x >= WIDTH - 6) x = WIDTH - 6;
-                if (y >= HEIGHT - 8) y = HEIGHT - 8;
-            }
-        } else if (isBoss) {
-            if (moveCounter % 3 == 0) {
-                x += direction;
-                if (x <= 1 || x >= WIDTH - 2) {
-                    direction = -direction;
-                    if (rand() % 2 == 0) {
-                        y++;
-                    }
-                }
-            }
-        } else {
-            if (moveCounter % 3 == 0) {
-                x += direction;
-                if (x <= 1 || x >= WIDTH - 2) {
-                    direction = -direction;
-                }
-            }
-        }
-        
-        if (shootCooldown > 0) shootCooldown--;
-    }
-    
-    vector<Bullet> shoot() {
-        vector<Bullet> newBullets;
-        
-        if (shootCooldown > 0) return newBullets;
-        
-        if (isGiantBoss) {
-            if (patternCounter % 30 == 0) {
-                for (int i = -2; i <= 2; i++) {
-                    newBullets.emplace_back(x + i, y + 3, false, true);
-                }
-                shootCooldown = 45;
-            }
-            
-            if (patternCounter % 60 == 0) {
-                newBullets.emplace_back(x - 4, y + 3, false, false);
-                newBullets.emplace_back(x + 4, y + 3, false, false);
-                newBullets.emplace_back(x, y + 3, false, false);
-                shootCooldown = 30;
-            }
-        } else if (isBoss) {
-            if (rand() % 150 < 2) {
-                newBullets.emplace_back(x, y + 1, false);
-                shootCooldown = 25;
-            }
-        } else {
-            if (rand() % 200 < 2) {
-                newBullets.emplace_back(x, y + 1, false);
-                shootCooldown = 30;
-            }
-        }
-        
-        return newBullets;
+    cout << "Profile: " << profiler.storedFrames() << " frames written to " << path << endl;
+    return true;
+}
+
+// Points `cast` at `recorder` when a recording was asked for.
+bool openCast(SessionRecorder& recorder, SessionRecorder*& cast, const string& path) {
+    cast = nullptr;
+    if (path.empty()) return true;
+    if (!recorder.open(path)) {
+        cerr << "cannot write " << path << endl;
+        return false;
     }
-};
+    cast = &recorder;
+    return true;
+}
 
-class ResponsiveGame {
-private:
-    ConsoleRenderer renderer;
-    int playerX;
-    int score;
-    int lives;
-    int wave;
-    bool gameOver;
-    bool showTitleScreen;
-    bool showMechanics;
-    int titleSelection;
-    
-    vector<Bullet> bullets;
-    vector<Enemy> enemies;
-    
-    bool leftPressed;
-    bool rightPressed;
-    bool spacePressed;
-    bool upPressed;
-    bool downPressed;
-    bool enterPressed;
-    
-    chrono::steady_clock::time_point lastFrame;
-    int frameCount;
-    int shootCooldown;
-    int mechanicsDisplayTime;
-    bool giantBossSpawnedThisWave;
-    
-public:
-    ResponsiveGame() : playerX(WIDTH / 2), score(0), lives(10), wave(1), gameOver(false),
-                      showTitleScreen(true), showMechanics(false), titleSelection(0),
-                      leftPressed(false), rightPressed(false), spacePressed(false),
-                      upPressed(false), downPressed(false), enterPressed(false),
-                      frameCount(0), shootCooldown(0), mechanicsDisplayTime(0),
-                      giantBossSpawnedThisWave(false) {
-        createEnemyWave();
-        lastFrame = chrono::steady_clock::now();
-    }
-    
-    void createEnemyWave() {
-        enemies.clear();
-        giantBossSpawnedThisWave = false;
-        
-        for (int i = 0; i < 8; i++) {
-            for (int j = 0; j < 3; j++) {
-                Enemy enemy(10 + i * 8, 3 + j * 2);
-                enemy.direction = (j % 2 == 0) ? 1 : -1;
-                enemies.push_back(enemy);
-            }
-        }
+// `frameMs` 0 leaves out the capture cost, which a lossless run inflates
+// with the time spent waiting for the writer.
+void printCastStats(const SessionRecorder& cast, const string& path, double frameMs) {
+    cout << "Recording: " << cast.capturedFrames() << " frames (" << cast.keyframeCount() << " keyframes, "
+         << cast.droppedFrames() << " dropped) | " << cast.bytesWritten() << " bytes to " << path;
+    if (frameMs > 0) {
+        cout << " | capture " << cast.meanCaptureUs() << " us/frame ("
+             << cast.meanCaptureUs() / 10 / frameMs << "% of frame time)";
     }
-    
-    void spawnRegularBoss() {
-        Enemy boss(WIDTH / 2, 2, true, false);
-        enemies.push_back(boss);
-    }
-    
-    void spawnGiantBoss() {
-        Enemy giantBoss(WIDTH / 2, 3, true, true);
-        enemies.push_back(giantBoss);
-        giantBossSpawnedThisWave = true;
-        cout << endl << " WARNING: GIANT BOSS INCOMING! " << endl;
-    }
-    
-    void drawGiantBoss(int x, int y, int health) {
-        renderer.setChar(x, y, '^');
-        
-        renderer.setChar(x - 1, y + 1, '/');
-        renderer.setChar(x, y + 1, '|');
-        renderer.setChar(x + 1, y + 1, '\\');
-        
-        renderer.setChar(x - 2, y + 2, '[');
-        renderer.setChar(x - 1, y + 2, '=');
-        renderer.setChar(x, y + 2, 'O');
-        renderer.setChar(x + 1, y + 2, '=');
-        renderer.setChar(x + 2, y + 2, ']');
-        
-        renderer.setChar(x - 3, y + 3, '<');
-        renderer.setChar(x - 2, y + 3, '=');
-        renderer.setChar(x - 1, y + 3, '=');
-        renderer.setChar(x, y + 3, 'V');
-        renderer.setChar(x + 1, y + 3, '=');
-        renderer.setChar(x + 2, y + 3, '=');
-        renderer.setChar(x + 3, y + 3, '>');
-        
-        renderer.setChar(x - 2, y + 4, '|');
-        renderer.setChar(x - 1, y + 4, '|');
-        renderer.setChar(x, y + 4, '|');
-        renderer.setChar(x + 1, y + 4, '|');
-        renderer.setChar(x + 2, y + 4, '|');
-        
-        int healthBarWidth = 15;
-        int healthSegment = (healthBarWidth * health) / 15;
-        if (healthSegment < 1) healthSegment = 1;
-        
-        for (int i = 0; i < healthBarWidth; i++) {
-            char healthChar;
-            if (i < healthSegment) {
-                healthChar = '=';
-            } else {
-                healthChar = ' ';
-            }
-            renderer.setChar(x - healthBarWidth/2 + i, y - 1, healthChar);
-        }
-        
-        string bossLabel = "BOSS";
-        for (int i = 0; i < bossLabel.length(); i++) {
-            renderer.setChar(x - 2 + i, y - 2, bossLabel[i]);
-        }
+    cout << endl;
+}
+
+int runHeadless(long long ticks, uint64_t seed, int worldWidth, int worldHeight, bool showStats,
+                const string& recordPath, const string& profilePath, const string& castPath,
+                double tickRate, ParallelUpdate* parallel) {
+    RandomInput input(seed);
+    ResponsiveGame game(&input, seed, worldWidth, worldHeight);
+    game.setParallelUpdate(parallel);
+    NullStream sink;
+
+    FrameProfiler profiler;
+    profiler.setEnabled(!profilePath.empty());
+    game.setProfiler(&profiler);
+
+    ReplayRecorder* recorder = nullptr;
+    if (!recordPath.empty()) {
+        recorder = new ReplayRecorder(&input, recordPath, seed, game.getWorldWidth(), game.getWorldHeight());
+        if (!recorder->isOpen()) {
+            cerr << "cannot write " << recordPath << endl;
+            delete recorder;
+            return 1;
+        }
+        game.setInput(recorder);
     }
-    
-    void updateInput() {
-        leftPressed = rightPressed = spacePressed = false;
-        upPressed = downPressed = enterPressed = false;
-        
-        while (_kbhit()) {
-            char key = _getch();
-            
-            if (key == 0 || key == -32) {
-                key = _getch();
-                switch (key) {
-                    case 72: upPressed = true; break;
-                    case 80: downPressed = true; break;
-                    case 75: leftPressed = true; break;
-                    case 77: rightPressed = true; break;
-                }
-            } else {
-                switch (key) {
-                    case 'a': case 'A': leftPressed = true; break;
-                    case 'd': case 'D': rightPressed = true; break;
-                    case 'w': case 'W': upPressed = true; break;
-                    case 's': case 'S': downPressed = true; break;
-                    case ' ': spacePressed = true; break;
-                    case '\r': enterPressed = true; break;
-                    case 'q': case 'Q': gameOver = true; break;
-                    case 'r': case 'R': resetGame(); break;
-                    case 'm': case 'M': toggleMechanics(); break;
-                }
-            }
-        }
-        
-        if (showTitleScreen) {
-            if (upPressed) titleSelection = (titleSelection - 1 + 2) % 2;
-            if (downPressed) titleSelection = (titleSelection + 1) % 2;
-            if (enterPressed) {
-                if (titleSelection == 0) {
-                    showTitleScreen = false;
-                } else {
-                    gameOver = true;
-                }
-            }
-            return;
-        }
-        
-        if (rightPressed && leftPressed) {
-            if (playerX < WIDTH / 2) {
-                leftPressed = false;
-            } else {
-                rightPressed = false;
-            }
-        }
-        
-        if (rightPressed && !leftPressed) {
-            if (playerX < WIDTH - 2) playerX += 2;
-        } else if (leftPressed && !rightPressed) {
-            if (playerX > 1) playerX -= 2;
-        }
-        
-        if (spacePressed && shootCooldown <= 0) {
-            bullets.emplace_back(playerX, PLAYER_POS - 1, true);
-            shootCooldown = 8;
-        }
-        
-        if (shootCooldown > 0) shootCooldown--;
-        
-        if (mechanicsDisplayTime > 0) {
-            mechanicsDisplayTime--;
-            if (mechanicsDisplayTime == 0) {
-                showMechanics = false;
-            }
-        }
+
+    // A headless recording is stamped in game time, one frame per tick,
+    // and keeps every frame however fast the run goes.
+    SessionRecorder castRecorder;
+    SessionRecorder* cast;
+    if (!openCast(castRecorder, cast, castPath)) {
+        delete recorder;
+        return 1;
     }
-    
-    void toggleMechanics() {
-        showMechanics = !showMechanics;
-        if (showMechanics) {
-            mechanicsDisplayTime = 180;
-        }
+    if (cast) cast->setLossless(true);
+    double msPerTick = 1000 / (tickRate > 0 ? tickRate : 60.0);
+
+    auto start = chrono::steady_clock::now();
+    long long ticksRun = 0;
+
+    while (ticksRun < ticks && !game.isGameOver()) {
+        profiledTick(game, profiler);
+        if (recorder) recorder->endTick(game);
+        if (showStats || profiler.isEnabled() || cast) profiledRender(game, profiler, sink);
+        ticksRun++;
+        if (cast) cast->capture(game.getRenderer(), (int64_t)(ticksRun * msPerTick));
     }
-    
-    void updateGame() {
-        if (gameOver || showTitleScreen) return;
-        
-        auto currentTime = chrono::steady_clock::now();
-        float deltaTime = chrono::duration<float>(currentTime - lastFrame).count();
-        lastFrame = currentTime;
-        frameCount++;
-        
-        for (auto& bullet : bullets) {
-            bullet.update();
-        }
-        
-        bullets.erase(remove_if(bullets.begin(), bullets.end(),
-            [](const Bullet& b) { return !b.active; }), bullets.end());
-        
-        for (auto& enemy : enemies) {
-            if (enemy.alive) {
-                enemy.update();
-                
-                vector<Bullet> newBullets = enemy.shoot();
-                for (const auto& bullet : newBullets) {
-                    bullets.push_back(bullet);
-                }
-            }
-        }
-        
-        checkCollisions();
-        
-        if (frameCount % 900 == 0) {
-            spawnRegularBoss();
-        }
-        
-        bool allRegularEnemiesDead = true;
-        for (const auto& enemy : enemies) {
-            if (enemy.alive && !enemy.isBoss) {
-                allRegularEnemiesDead = false;
-                break;
-            }
-        }
-        
-        if (allRegularEnemiesDead && enemies.size() > 0) {
-            bool hasBoss = false;
-            for (const auto& enemy : enemies) {
-                if (enemy.alive && enemy.isBoss) {
-                    hasBoss = true;
-                    break;
-                }
-            }
-            
-            if (!hasBoss) {
-                if (wave % 3 == 0 && !giantBossSpawnedThisWave) {
-                    spawnGiantBoss();
-                } else {
-                    wave++;
-                    createEnemyWave();
-                }
-            }
-        }
-        
-        if (giantBossSpawnedThisWave) {
-            bool giantBossAlive = false;
-            for (const auto& enemy : enemies) {
-                if (enemy.alive && enemy.isGiantBoss) {
-                    giantBossAlive = true;
-                    break;
-                }
-            }
-            
-            if (!giantBossAlive && giantBossSpawnedThisWave) {
-                static int giantBossDefeatTimer = 0;
-                giantBossDefeatTimer++;
-                
-                if (giantBossDefeatTimer > 180) {
-                    wave++;
-                    createEnemyWave();
-                    giantBossDefeatTimer = 0;
-                }
-            }
-        }
-        
-        if (lives <= 0) gameOver = true;
-    }
-    
-    void checkCollisions() {
-        for (auto& bullet : bullets) {
-            if (!bullet.playerBullet || !bullet.active) continue;
-            
-            for (auto& enemy : enemies) {
-                if (!enemy.alive) continue;
-                
-                if (enemy.isGiantBoss) {
-                    int distanceX = abs(bullet.x - enemy.x);
-                    int distanceY = abs(bullet.y - enemy.y);
-                    
-                    if (distanceX <= 4 && distanceY <= 2) {
-                        enemy.health--;
-                        bullet.active = false;
-                        
-                        if (enemy.health <= 0) {
-                            enemy.alive = false;
-                            score += 300;
-                        }
-                        break;
-                    }
-                } else {
-                    int distanceX = abs(bullet.x - enemy.x);
-                    int distanceY = abs(bullet.y - enemy.y);
-                    
-                    if (distanceX <= 1 && distanceY <= 1) {
-                        enemy.health--;
-                        bullet.active = false;
-                        
-                        if (enemy.health <= 0) {
-                            enemy.alive = false;
-                            if (enemy.isBoss) {
-                                score += 100;
-                            } else {
-                                score += 10;
-                            }
-                        }
-                        break;
-                    }
+    delete recorder;
+    if (cast) cast->stop((int64_t)(ticksRun * msPerTick));
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "ticks=" << ticksRun
+         << " seconds=" << seconds
+         << " ticks_per_sec=" << (seconds > 0 ? ticksRun / seconds : 0)
+         << " score=" << game.getScore()
+         << " wave=" << game.getWave()
+         << " lives=" << game.getLives()
+         << " game_over=" << (game.isGameOver() ? 1 : 0);
+    if (showStats) {
+        cout << " bytes_per_frame=" << game.getRenderer().getAverageFrameBytes();
+    }
+    cout << endl;
+    if (cast) printCastStats(*cast, castPath, 0);
+    return writeProfile(profiler, profilePath) ? 0 : 1;
+}
+
+// Re-simulates a recorded session as fast as the CPU allows and stops at
+// the first checksum that does not match.
+int runReplay(const string& path) {
+    ReplayPlayer player;
+    string error;
+    if (!player.load(path, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    ResponsiveGame game(&player, player.getSeed(), player.getWorldWidth(), player.getWorldHeight());
+
+    auto start = chrono::steady_clock::now();
+    while (!player.finished()) {
+        game.updateInput();
+        game.updateGame();
+        player.endTick(game);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (player.getDivergedTick() >= 0) {
+        cout << "diverged tick=" << player.getDivergedTick() << hex
+             << " expected=" << player.getExpectedHash()
+             << " actual=" << player.getActualHash() << dec << endl;
+        return 2;
+    }
+
+    cout << "ticks=" << player.getTicks()
+         << " seconds=" << seconds
+         << " ticks_per_sec=" << (seconds > 0 ? player.getTicks() / seconds : 0)
+         << " checkpoints=" << player.getCheckpointCount()
+         << " score=" << game.getScore()
+         << " wave=" << game.getWave()
+         << " hash=" << hex << game.stateHash() << dec << endl;
+    return 0;
+}
+
+// Plays a headless session while keeping the last ROLLBACK_WINDOW ticks as
+// snapshots, and every so often rewinds half of that window and
+// resimulates it from the logged inputs. Any difference from the first
+// run means some state escaped the snapshot.
+int runRollbackCheck(long long ticks, uint64_t seed, int worldWidth, int worldHeight) {
+    const int ROLLBACK_WINDOW = 120;
+    const int ROLLBACK_DEPTH = 60;
+
+    RandomInput input(seed);
+    ResponsiveGame game(nullptr, seed, worldWidth, worldHeight);
+    SnapshotRing ring(ROLLBACK_WINDOW);
+    vector<unsigned> inputs(ROLLBACK_WINDOW);
+    vector<uint64_t> hashes(ROLLBACK_WINDOW);
+
+    double saveNs = 0, loadNs = 0;
+    long long saves = 0, rollbacks = 0;
+    size_t maxBytes = 0;
+    long long tick = 0;
+
+    while (tick < ticks && !game.isGameOver()) {
+        auto t0 = chrono::steady_clock::now();
+        Snapshot& snapshot = ring.push();
+        game.saveSnapshot(snapshot);
+        saveNs += chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count();
+        saves++;
+        maxBytes = max(maxBytes, snapshot.bytes());
+
+        unsigned keys = input.poll();
+        inputs[tick % ROLLBACK_WINDOW] = keys;
+        game.applyInput(keys);
+        game.updateGame();
+        hashes[tick % ROLLBACK_WINDOW] = game.stateHash();
+        tick++;
+
+        if (tick % ROLLBACK_WINDOW == 0) {
+            long long from = tick - ROLLBACK_DEPTH;
+            ring.discard(ROLLBACK_DEPTH - 1);
+
+            auto t1 = chrono::steady_clock::now();
+            game.loadSnapshot(ring.back());
+            loadNs += chrono::duration<double, nano>(chrono::steady_clock::now() - t1).count();
+            ring.discard(1);
+            rollbacks++;
+
+            for (long long t = from; t < tick; t++) {
+                game.saveSnapshot(ring.push());
+                game.applyInput(inputs[t % ROLLBACK_WINDOW]);
+                game.updateGame();
+                if (game.stateHash() != hashes[t % ROLLBACK_WINDOW]) {
+                    cout << "rollback diverged at tick " << t + 1 << endl;
+                    return 2;
                 }
             }
         }
-        
-        for (auto& bullet : bullets) {
-            if (bullet.playerBullet || !bullet.active) continue;
-            
-            if (bullet.y == PLAYER_POS && abs(bullet.x - playerX) <= 1) {
-                bullet.active = false;
-                lives--;
-                if (lives <= 0) gameOver = true;
-            }
-        }
     }
-    
-    void renderTitleScreen() {
-        renderer.clear();
-        
-        string title = "RESPONSIVE GALAGA";
-        int titleX = (WIDTH - title.length()) / 2;
-        
-        for (int i = 0; i < title.length(); i++) {
-            renderer.setChar(titleX + i, 5, title[i]);
-        }
-        
-        string startText = "> START GAME <";
-        string exitText = "> EXIT GAME <";
-        
-        if (titleSelection == 0) {
-            startText = "> START GAME <";
-            exitText = "  EXIT GAME  ";
-        } else {
-            startText = "  START GAME  ";
-            exitText = "> EXIT GAME <";
-        }
-    
-        int startX = (WIDTH - startText.length()) / 2;
-        int exitX = (WIDTH - exitText.length()) / 2;
-        
-        for (int i = 0; i < startText.length(); i++) {
-            renderer.setChar(startX + i, 10, startText[i]);
-        }
-        
-        for (int i = 0; i < exitText.length(); i++) {
-            renderer.setChar(exitX + i, 12, exitText[i]);
-        }
-        
-        string controls = "CONTROLS: ARROWS/ENTER/M";
-        int controlsX = (WIDTH - controls.length()) / 2;
-        for (int i = 0; i < controls.length(); i++) {
-            renderer.setChar(controlsX + i, 16, controls[i]);
+
+    cout << "ticks=" << tick
+         << " rollbacks=" << rollbacks
+         << " save_us=" << (saves ? saveNs / saves / 1000 : 0)
+         << " load_us=" << (rollbacks ? loadNs / rollbacks / 1000 : 0)
+         << " max_snapshot_bytes=" << maxBytes
+         << " score=" << game.getScore()
+         << " wave=" << game.getWave() << endl;
+    return 0;
+}
+
+// Plays the same seeded stress field twice, once with the plain update and
+// once with the entity passes split over `threads`, and compares state
+// hashes after every tick. Small chunks put plenty of chunk boundaries in
+// every lane. Exits 2 at the first tick the two disagree.
+int runParallelCheck(long long ticks, uint64_t seed, int worldWidth, int worldHeight, int threads) {
+    const int entities = 40000;
+    ParallelUpdate parallel(max(threads, 1), 256);
+
+    RandomInput serialInput(seed), parallelInput(seed);
+    ResponsiveGame serial(nullptr, seed, worldWidth, worldHeight);
+    serial.spawnStressField(entities / 2, entities / 2);
+    ResponsiveGame split = serial;
+    split.setParallelUpdate(&parallel);
+
+    double serialNs = 0, splitNs = 0;
+    long long tick = 0;
+    while (tick < ticks && !serial.isGameOver()) {
+        serial.applyInput(serialInput.poll());
+        auto t0 = chrono::steady_clock::now();
+        serial.updateGame();
+        auto t1 = chrono::steady_clock::now();
+
+        split.applyInput(parallelInput.poll());
+        auto t2 = chrono::steady_clock::now();
+        split.updateGame();
+        auto t3 = chrono::steady_clock::now();
+
+        serialNs += chrono::duration<double, nano>(t1 - t0).count();
+        splitNs += chrono::duration<double, nano>(t3 - t2).count();
+        tick++;
+
+        if (serial.stateHash() != split.stateHash()) {
+            cout << "parallel update diverged at tick " << tick << hex
+                 << " serial=" << serial.stateHash() << " parallel=" << split.stateHash() << dec << endl;
+            return 2;
         }
-        
-        renderer.draw();
-        
-        cout << "\r\n";
-        cout << "  FEATURES:                                         \r\n";
-        cout << "  - Classic space shooter                           \r\n";
-        cout << "  - Regular & GIANT BOSS battles!                   \r\n";
-        cout << "  - Responsive controls                             \r\n";
-        cout << "  - Multiple enemy waves                            \r\n";
-        cout << "  - Mechanics display (M key)                       \r\n";
-        cout << "\r\n";
-        cout << "  MECHANICS:                                        \r\n";
-        cout << "  - Enemies: 10 pts, Bosses: 100 pts               \r\n";
-        cout << "  - GIANT BOSS: 300 pts, 15 HP!                    \r\n";
-        cout << "  - Giant boss appears every 3 waves               \r\n";
-        cout << "  - Start with 10 lives                            \r\n";
-        cout << "\r\n";
-    }
-    
-    void renderMechanics() {
-        int boxWidth = 50;
-        int boxHeight = 16;
-        int boxX = (WIDTH - boxWidth) / 2;
-        int boxY = (HEIGHT - boxHeight) / 2;
-        
-        for (int x = boxX; x < boxX + boxWidth; x++) {
-            renderer.setChar(x, boxY, '=');
-            renderer.setChar(x, boxY + boxHeight - 1, '=');
+    }
+
+    cout << "ticks=" << tick
+         << " threads=" << parallel.threadCount()
+         << " chunk=" << parallel.getChunkSize()
+         << " enemies_left=" << serial.getAliveEnemyCount()
+         << " bullets_left=" << serial.getBulletCount()
+         << " serial_us_per_tick=" << (tick ? serialNs / tick / 1000 : 0)
+         << " parallel_us_per_tick=" << (tick ? splitNs / tick / 1000 : 0)
+         << " hash=" << hex << serial.stateHash() << dec << endl;
+    return 0;
+}
+
+template <typename Check>
+double timeCollisions(const ResponsiveGame& field, int repeats, Check check, ResponsiveGame& result) {
+    double totalNs = 0;
+    for (int r = 0; r < repeats; r++) {
+        result = field;
+        auto start = chrono::steady_clock::now();
+        check(result);
+        totalNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    }
+    return totalNs / repeats;
+}
+
+// Times checkCollisions against the brute-force scan on fields of growing
+// size and checks that both agree on the outcome.
+int runStress(int entities, uint64_t seed, int worldWidth, int worldHeight) {
+    cout << "entities,enemies,bullets,grid_ns,brute_ns,grid_ns_per_entity,speedup,match" << endl;
+
+    for (int count = max(entities / 8, 1); count <= entities; count *= 2) {
+        ResponsiveGame field(nullptr, seed, worldWidth, worldHeight);
+        field.spawnStressField(count, count);
+
+        ResponsiveGame gridResult, bruteResult;
+        int repeats = max(3, 200000 / count);
+        double gridNs = timeCollisions(field, repeats,
+            [](ResponsiveGame& g) { g.checkCollisions(); }, gridResult);
+        double bruteNs = timeCollisions(field, max(1, repeats / 10),
+            [](ResponsiveGame& g) { g.checkCollisionsBruteForce(); }, bruteResult);
+
+        bool match = gridResult.getScore() == bruteResult.getScore() &&
+                     gridResult.getLives() == bruteResult.getLives() &&
+                     gridResult.getAliveEnemyCount() == bruteResult.getAliveEnemyCount();
+
+        cout << count * 2 << "," << count << "," << count << ","
+             << gridNs << "," << bruteNs << "," << gridNs / (count * 2) << ","
+             << bruteNs / gridNs << "," << (match ? "yes" : "NO") << endl;
+        if (!match) return 1;
+    }
+    return 0;
+}
+
+// Times the batched entity update passes on a freshly spawned field of
+// `entities` enemies and bullets, re-spawning between samples so the
+// bullet count doesn't decay while measuring.
+int runUpdateBench(int entities, uint64_t seed, int worldWidth, int worldHeight, ParallelUpdate* parallel) {
+    const int samples = 20;
+    const int ticksPerSample = 4;
+    double totalNs = 0;
+    double totalEntityTicks = 0;
+
+    ResponsiveGame game(nullptr, seed, worldWidth, worldHeight);
+    game.setParallelUpdate(parallel);
+    for (int s = 0; s < samples; s++) {
+        game.spawnStressField(entities / 2, entities - entities / 2);
+        for (int t = 0; t < ticksPerSample; t++) {
+            double live = (double)game.getBulletCount() + game.getAliveEnemyCount();
+            auto start = chrono::steady_clock::now();
+            game.updateEntities();
+            totalNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            totalEntityTicks += live;
         }
-        for (int y = boxY; y < boxY + boxHeight; y++) {
-            renderer.setChar(boxX, y, '|');
-            renderer.setChar(boxX + boxWidth - 1, y, '|');
+    }
+
+    cout << "entities=" << entities
+         << " threads=" << (parallel ? parallel->threadCount() : 1)
+         << " ns_per_tick=" << totalNs / (samples * ticksPerSample)
+         << " ns_per_entity=" << totalNs / totalEntityTicks << endl;
+    return 0;
+}
+
+// Bullet-hell load: enough emitters to fill about half the pool cycle
+// through the ring, spiral, aimed and fan patterns into one pooled store,
+// and we time the pattern emission plus the bullet update for each tick.
+int runPatternBench(int targetBullets, uint64_t seed) {
+    const int emitterCount = max(1, targetBullets / 400);
+    const int ticks = 2000;
+    const int warmup = 200;
+    const int shapes[] = { PATTERN_RING_16, PATTERN_SPIRAL_6, PATTERN_AIMED_BURST_5, PATTERN_FAN_9 };
+
+    BulletStore bullets(WIDTH, HEIGHT);
+    bullets.reserve(BULLET_PATTERN, targetBullets);
+
+    Rng rng(seed);
+    vector<int> emitterX(emitterCount), emitterY(emitterCount), emitterPeriod(emitterCount);
+    for (int e = 0; e < emitterCount; e++) {
+        emitterX[e] = 4 + rng.nextInt(WIDTH - 8);
+        emitterY[e] = 1 + rng.nextInt(HEIGHT - 2);
+        emitterPeriod[e] = 1 + rng.nextInt(2);
+    }
+
+    double totalNs = 0;
+    double liveSum = 0;
+    long long emitted = 0;
+    size_t peak = 0;
+
+    for (int t = 0; t < ticks + warmup; t++) {
+        auto start = chrono::steady_clock::now();
+
+        bullets.update();
+        size_t before = bullets.size();
+        for (int e = 0; e < emitterCount; e++) {
+            if (t % emitterPeriod[e] != 0) continue;
+            const BulletPattern& pattern = PATTERNS[shapes[(e + t / 60) % 4]];
+            emitPattern(pattern, emitterX[e], emitterY[e], WIDTH / 2, PLAYER_POS, t, bullets);
         }
-        
-        string title = "GAME MECHANICS";
-        int titleX = boxX + (boxWidth - title.length()) / 2;
-        for (int i = 0; i < title.length(); i++) {
-            renderer.setChar(titleX + i, boxY + 1, title[i]);
+
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        if (t < warmup) continue;
+
+        totalNs += ns;
+        liveSum += bullets.size();
+        emitted += bullets.size() - before;
+        peak = max(peak, bullets.size());
+    }
+
+    cout << "capacity=" << targetBullets
+         << " emitters=" << emitterCount
+         << " avg_live=" << liveSum / ticks
+         << " peak_live=" << peak
+         << " emitted_per_tick=" << (double)emitted / ticks
+         << " dropped=" << bullets.getDropped()
+         << " ns_per_tick=" << totalNs / ticks
+         << " ns_per_bullet=" << totalNs / liveSum << endl;
+    return 0;
+}
+
+// Both ships of a co-op session, on the same tick on every peer.
+void startCoopGame(ResponsiveGame& game, const LockstepSession& session) {
+    game.enableCoop();
+    game.restart(session.getConfig().seed);
+    game.setViewShip(session.isHost() ? 0 : 1);
+}
+
+void printLockstepStats(const string& peer, const LockstepStats& stats, const ResponsiveGame& game) {
+    cout << "peer=" << peer
+         << " ticks=" << stats.ticks
+         << " packets_sent=" << stats.packetsSent
+         << " packets_received=" << stats.packetsReceived
+         << " simulated_drops=" << stats.packetsDropped
+         << " bytes_per_tick=" << (stats.ticks ? (double)stats.bytesSent / stats.ticks : 0)
+         << " stalls=" << stats.stalls
+         << " stall_ticks=" << stats.stallTicks
+         << " hashes_compared=" << stats.hashesCompared
+         << " desyncs=" << stats.desyncs;
+    if (stats.firstDesyncTick >= 0) cout << " first_desync_tick=" << stats.firstDesyncTick;
+    cout << " score=" << game.getScore()
+         << " hash=" << hex << game.stateHash() << dec << endl;
+}
+
+// One headless peer of --lockstep-test, paced at the tick rate and driven
+// by a random bot. `desyncAt` >= 0 makes this peer take one extra step
+// the other never sees, to check that the hashes catch it.
+struct LockstepPeer {
+    LockstepSession* session;
+    long long ticks;
+    double tickRate;
+    uint64_t inputSeed;
+    long long desyncAt;
+    ResponsiveGame game;
+    bool connected;
+
+    void run() {
+        int64_t deadline = netClockUs() + 5000000;
+        while (!session->handshake()) {
+            if (session->welcomeRefused() || netClockUs() > deadline) return;
+            this_thread::sleep_for(chrono::milliseconds(1));
         }
-        
-        vector<string> mechanics = {
-            "CONTROLS:",
-            "  A/D or ARROWS: Move",
-            "  SPACE: Shoot",
-            "  M: Show/Hide Mechanics",
-            "  R: Restart",
-            "  Q: Quit",
-            "",
-            "SCORING:",
-            "  Regular Enemy: 10 pts",
-            "  Boss Enemy: 100 pts",
-            "  GIANT BOSS: 300 pts",
-            "  Boss HP: 3, Giant: 15",
-            "",
-            "GIANT BOSS SPAWN:",
-            "  - Appears every 3 waves",
-            "  - Only after clearing all",
-            "    regular enemies",
-            "",
-            "Press M to close"
-        };
-        
-        for (int i = 0; i < mechanics.size(); i++) {
-            int textX = boxX + 2;
-            string line = mechanics[i];
-            for (int j = 0; j < line.length(); j++) {
-                if (textX + j < boxX + boxWidth - 2) {
-                    renderer.setChar(textX + j, boxY + 3 + i, line[j]);
+        connected = true;
+
+        const LockstepConfig& config = session->getConfig();
+        game = ResponsiveGame(nullptr, config.seed, config.worldWidth, config.worldHeight);
+        startCoopGame(game, *session);
+
+        RandomInput input(inputSeed);
+        FixedStepLoop loop(tickRate, tickRate);
+        loop.run(
+            [&]() {
+                if (session->advance(game, input) && session->currentTick() == desyncAt) {
+                    game.applyInput(INPUT_LEFT);
                 }
-            }
+            },
+            []() {},
+            [&]() {
+                return session->currentTick() < ticks && !game.isGameOver() && !session->peerTimedOut();
+            });
+
+        // Keep answering for a moment so the other side can finish too.
+        int64_t lingerUntil = netClockUs() + 200000 + config.latencyMs * 4000 + config.jitterMs * 4000;
+        while (netClockUs() < lingerUntil) {
+            session->linger();
+            this_thread::sleep_for(chrono::milliseconds(1));
         }
     }
-    
-    void render() {
-        if (showTitleScreen) {
-            renderTitleScreen();
-            return;
-        }
-        
-        renderer.clear();
-        
-        renderer.setChar(playerX, PLAYER_POS, 'A');
-        renderer.setChar(playerX - 1, PLAYER_POS, '<');
-        renderer.setChar(playerX + 1, PLAYER_POS, '>');
-        
-        for (const auto& bullet : bullets) {
-            if (bullet.active) {
-                if (bullet.bossSpreadBullet) {
-                    renderer.setChar(bullet.x, bullet.y, '*');
-                } else {
-                    renderer.setChar(bullet.x, bullet.y, bullet.playerBullet ? '|' : '!');
-                }
-            }
+};
+
+// Host and joiner over real sockets on 127.0.0.1, each on its own thread
+// behind its own simulated link. Exits 2 if the peers ever disagree.
+int runLockstepTest(long long ticks, const LockstepConfig& config, double tickRate, long long desyncAt) {
+    UdpSocket hostSocket, joinSocket;
+    if (!hostSocket.open(0) || !joinSocket.open(0) ||
+        !joinSocket.setPeer("127.0.0.1", hostSocket.localPort())) {
+        cerr << "cannot open loopback sockets" << endl;
+        return 1;
+    }
+
+    LockstepSession hostSession(hostSocket, true, config, config.seed * 2 + 1);
+    LockstepSession joinSession(joinSocket, false, config, config.seed * 2 + 2);
+    LockstepPeer hostPeer = { &hostSession, ticks, tickRate, config.seed, -1, ResponsiveGame(), false };
+    LockstepPeer joinPeer = { &joinSession, ticks, tickRate, config.seed + 1, desyncAt, ResponsiveGame(), false };
+
+    auto start = chrono::steady_clock::now();
+    thread hostThread(&LockstepPeer::run, &hostPeer);
+    thread joinThread(&LockstepPeer::run, &joinPeer);
+    hostThread.join();
+    joinThread.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (!hostPeer.connected || !joinPeer.connected) {
+        cerr << "handshake timed out" << endl;
+        return 1;
+    }
+
+    printLockstepStats("host", hostSession.getStats(), hostPeer.game);
+    printLockstepStats("join", joinSession.getStats(), joinPeer.game);
+
+    bool match = hostSession.currentTick() == joinSession.currentTick() &&
+                 hostPeer.game.stateHash() == joinPeer.game.stateHash();
+    bool desynced = hostSession.getStats().desyncs > 0 || joinSession.getStats().desyncs > 0;
+    cout << "seconds=" << seconds << " final_state_match=" << (match ? "yes" : "NO")
+         << " desync_detected=" << (desynced ? "yes" : "no") << endl;
+    return match && !desynced ? 0 : 2;
+}
+
+// Interactive co-op: the keyboard flies this peer's ship and the viewport
+// follows it. A tick whose partner input hasn't arrived is skipped and
+// counted as a stall.
+int runCoop(const string& joinAddress, int hostPort, const LockstepConfig& offered,
+            double tickRate, double renderRate, bool showStats) {
+    bool host = joinAddress.empty();
+    UdpSocket socket;
+    if (!socket.open(host ? (uint16_t)hostPort : 0)) {
+        cerr << "cannot open UDP port " << hostPort << endl;
+        return 1;
+    }
+    if (!host) {
+        size_t colon = joinAddress.rfind(':');
+        if (colon == string::npos ||
+            !socket.setPeer(joinAddress.substr(0, colon), (uint16_t)atoi(joinAddress.c_str() + colon + 1))) {
+            cerr << "--join wants IPV4:PORT" << endl;
+            return 1;
         }
-        
-        for (const auto& enemy : enemies) {
-            if (enemy.alive) {
-                if (enemy.isGiantBoss) {
-                    drawGiantBoss(enemy.x, enemy.y, enemy.health);
-                } else if (enemy.isBoss) {
-                    renderer.setChar(enemy.x, enemy.y, 'B');
-                    renderer.setChar(enemy.x - 1, enemy.y, '[');
-                    renderer.setChar(enemy.x + 1, enemy.y, ']');
-                    
-                    int healthWidth = enemy.health;
-                    for (int i = 0; i < healthWidth; i++) {
-                        renderer.setChar(enemy.x - 1 + i, enemy.y - 1, '=');
-                    }
-                } else {
-                    renderer.setChar(enemy.x, enemy.y, 'E');
-                    renderer.setChar(enemy.x - 1, enemy.y, '-');
-                    renderer.setChar(enemy.x + 1, enemy.y, '-');
-                }
-            }
+    }
+
+    LockstepSession session(socket, host, offered, (uint64_t)netClockUs());
+    if (host) {
+        cout << "Waiting for player 2 on UDP port " << socket.localPort() << "..." << endl;
+    } else {
+        cout << "Joining " << joinAddress << "..." << endl;
+    }
+    int64_t deadline = netClockUs() + 10000000;
+    while (!session.handshake()) {
+        if (session.welcomeRefused()) {
+            cerr << "the host's world is larger than " << MAX_WORLD_SIZE << "x" << MAX_WORLD_SIZE << endl;
+            return 1;
         }
-        
-        if (showMechanics) {
-            renderMechanics();
+        if (!host && netClockUs() > deadline) {
+            cerr << "no answer from " << joinAddress << endl;
+            return 1;
         }
-        
-        renderer.draw();
-        
-        cout << " Score: " << score << " | Lives: " << lives << " | Wave: " << wave;
-        
-        for (const auto& enemy : enemies) {
-            if (enemy.alive && enemy.isGiantBoss) {
-                cout << " | GIANT BOSS: " << enemy.health << " HP";
-                break;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    const LockstepConfig& config = session.getConfig();
+    Terminal terminal("Responsive Galaga - Co-op");
+    ThreadedKeyboardInput keyboard;
+    ResponsiveGame game(nullptr, config.seed, config.worldWidth, config.worldHeight);
+    startCoopGame(game, session);
+
+    int columns, rows;
+    if (terminal.getSize(columns, rows)) {
+        game.setViewSize(columns, rows - VIEW_FOOTER_ROWS);
+    }
+
+    FrameProfiler profiler;
+    RenderThread renderThread(cout, renderRate);
+    FixedStepLoop loop(tickRate, renderRate);
+    loop.run(
+        [&]() { session.advance(game, keyboard); },
+        [&]() { publishFrame(game, profiler, keyboard, renderThread); },
+        [&]() { return !game.isGameOver() && !session.peerTimedOut(); });
+
+    publishFrame(game, profiler, keyboard, renderThread);
+    renderThread.stop();
+    keyboard.stop();
+
+    int64_t lingerUntil = netClockUs() + 500000;
+    while (netClockUs() < lingerUntil) {
+        session.linger();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    cout << endl << (session.peerTimedOut() ? "Lost contact with the other player." : "Thanks for playing!") << endl;
+    if (showStats) printLockstepStats(host ? "host" : "join", session.getStats(), game);
+    terminal.pause();
+    return session.getStats().desyncs > 0 ? 2 : 0;
+}
+
+int main(int argc, char** argv) {
+    long long headlessTicks = 0;
+    long long rollbackTicks = 0;
+    int stressEntities = 0;
+    int updateBenchEntities = 0;
+    int patternBenchBullets = 0;
+    long long parallelCheckTicks = 0;
+    int updateThreads = 1;
+    bool showStats = false;
+    double tickRate = 60.0;
+    double renderRate = 60.0;
+    string recordPath;
+    string replayPath;
+    string profilePath;
+    string castPath;
+    int worldWidth = WIDTH;
+    int worldHeight = HEIGHT;
+    long long lockstepTestTicks = 0;
+    long long desyncAt = -1;
+    int hostPort = -1;
+    string joinAddress;
+    LockstepConfig lockstep;
+    uint64_t seed = (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessTicks = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--rollback-check") == 0 && i + 1 < argc) {
+            rollbackTicks = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+            stressEntities = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--update-bench") == 0 && i + 1 < argc) {
+            updateBenchEntities = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pattern-bench") == 0 && i + 1 < argc) {
+            patternBenchBullets = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--parallel-check") == 0 && i + 1 < argc) {
+            parallelCheckTicks = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--update-threads") == 0 && i + 1 < argc) {
+            updateThreads = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            tickRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            renderRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--cast") == 0 && i + 1 < argc) {
+            castPath = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc &&
+                   sscanf(argv[i + 1], "%dx%d", &worldWidth, &worldHeight) == 2) {
+            i++;
+            if (!worldSizeAllowed(worldWidth, worldHeight)) {
+                cerr << "world size must be at most " << MAX_WORLD_SIZE << "x" << MAX_WORLD_SIZE << endl;
+                return 1;
             }
+        } else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            hostPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--join") == 0 && i + 1 < argc) {
+            joinAddress = argv[++i];
+        } else if (strcmp(argv[i], "--lockstep-test") == 0 && i + 1 < argc) {
+            lockstepTestTicks = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--input-delay") == 0 && i + 1 < argc) {
+            lockstep.inputDelay = max(0, min(atoi(argv[++i]), 255));
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            lockstep.lossPercent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+            lockstep.latencyMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+            lockstep.jitterMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--desync-at") == 0 && i + 1 < argc) {
+            desyncAt = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            showStats = true;
+        } else {
+            cerr << "usage: galaga [--seed N] [--headless TICKS] [--stress ENEMIES] [--update-bench ENTITIES]\n"
+             << "              [--pattern-bench BULLETS] [--parallel-check TICKS] [--update-threads N]\n"
+             << "              [--tick-rate HZ] [--fps HZ] [--stats]\n"
+             << "              [--record FILE] [--replay FILE] [--rollback-check TICKS]\n"
+             << "              [--profile FILE.csv|FILE.json] [--world WIDTHxHEIGHT] [--cast FILE.gcast]\n"
+             << "              [--host PORT | --join IPV4:PORT | --lockstep-test TICKS] [--input-delay TICKS]\n"
+             << "              [--loss PERCENT] [--latency MS] [--jitter MS] [--desync-at TICK]" << endl;
+            return 1;
         }
-        
-        if (wave % 3 == 0 && !giantBossSpawnedThisWave) {
-            cout << " | NEXT: GIANT BOSS WAVE!";
-        }
-        
-        cout << " | Enemies: " << count_if(enemies.begin(), enemies.end(), 
-                                           [](const Enemy& e) { return e.alive; });
-        
-        cout << endl;
-        
-        cout << " [A/D] Move | [SPACE] Shoot | [R] Restart | [Q] Quit";
-        cout << " | [M] Mechanics";
-        
-        if (gameOver) {
-            cout << endl << " GAME OVER! Press R to restart or Q to quit";
-        }
-        
-        cout << endl;
-        
-        if (!showMechanics) {
-            vector<string> hints = {
-                "TIP: GIANT BOSS appears every 3 waves after clearing enemies!",
-                "TIP: Giant boss has 15 HP and fires spread patterns!",
-                "TIP: Regular bosses (100 pts) appear every 15 seconds",
-                "TIP: Regular bosses are slower and only have 3 HP!",
-                "TIP: Clear all regular enemies to advance to next wave!",
-                "TIP: Defeat the giant boss to earn 300 points!"
-            };
-            
-            int hintIndex = (frameCount / 300) % hints.size();
-            cout << " " << hints[hintIndex];
-        }
-        
-        cout << endl;
-    }
-    
-    void resetGame() {
-        playerX = WIDTH / 2;
-        score = 0;
-        lives = 10;
-        wave = 1;
-        gameOver = false;
-        showTitleScreen = true;
-        showMechanics = false;
-        titleSelection = 0;
-        leftPressed = rightPressed = spacePressed = false;
-        upPressed = downPressed = enterPressed = false;
-        bullets.clear();
-        enemies.clear();
-        createEnemyWave();
-        frameCount = 0;
-        shootCooldown = 0;
-        mechanicsDisplayTime = 0;
-        giantBossSpawnedThisWave = false;
-    }
-    
-    bool isGameOver() const { return gameOver; }
-    bool isShowingTitleScreen() const { return showTitleScreen; }
-};
+    }
 
-int main() {
-    system("title Responsive Galaga - Giant Boss Every 3 Waves");
-    system("cls");
-    
-    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    GetConsoleScreenBufferInfo(console, &csbi);
-    
-    COORD newSize;
-    newSize.X = csbi.dwSize.X;
-    newSize.Y = 1000;
-    SetConsoleScreenBufferSize(console, newSize);
-    
-    ResponsiveGame game;
-    
-    auto lastTime = chrono::steady_clock::now();
-    const double MS_PER_UPDATE = 1.0 / 60.0;
-    
-    while (!game.isGameOver()) {
-        auto currentTime = chrono::steady_clock::now();
-        double deltaTime = chrono::duration<double>(currentTime - lastTime).count();
-        lastTime = currentTime;
-        
-        game.updateInput();
-        game.updateGame();
-        game.render();
-        
-        this_thread::sleep_for(chrono::milliseconds(1));
+    if (!replayPath.empty()) {
+        return runReplay(replayPath);
+    }
+
+    if (rollbackTicks > 0) {
+        return runRollbackCheck(rollbackTicks, seed, worldWidth, worldHeight);
+    }
+
+    if (stressEntities > 0) {
+        return runStress(stressEntities, seed, worldWidth, worldHeight);
+    }
+
+    if (parallelCheckTicks > 0) {
+        return runParallelCheck(parallelCheckTicks, seed, worldWidth, worldHeight, max(updateThreads, 2));
+    }
+
+    if (patternBenchBullets > 0) {
+        return runPatternBench(patternBenchBullets, seed);
+    }
+
+    // One thread is the plain update; more split big waves over a pool.
+    if (updateBenchEntities > 0 || headlessTicks > 0) {
+        ParallelUpdate* parallel = updateThreads > 1 ? new ParallelUpdate(updateThreads) : nullptr;
+        int status = updateBenchEntities > 0
+            ? runUpdateBench(updateBenchEntities, seed, worldWidth, worldHeight, parallel)
+            : runHeadless(headlessTicks, seed, worldWidth, worldHeight, showStats, recordPath, profilePath,
+                          castPath, tickRate, parallel);
+        delete parallel;
+        return status;
+    }
+
+    if (tickRate <= 0 || renderRate <= 0) {
+        cerr << "tick rate and fps must be positive" << endl;
+        return 1;
+    }
+
+    lockstep.seed = seed;
+    lockstep.worldWidth = worldWidth;
+    lockstep.worldHeight = worldHeight;
+
+    if (lockstepTestTicks > 0) {
+        return runLockstepTest(lockstepTestTicks, lockstep, tickRate, desyncAt);
+    }
+
+    if (hostPort >= 0 || !joinAddress.empty()) {
+        return runCoop(joinAddress, hostPort, lockstep, tickRate, renderRate, showStats);
+    }
+
+    Terminal terminal("Responsive Galaga - Giant Boss Every 3 Waves");
+    ThreadedKeyboardInput keyboard;
+    ResponsiveGame game(&keyboard, seed, worldWidth, worldHeight);
+    ParallelUpdate* parallel = updateThreads > 1 ? new ParallelUpdate(updateThreads) : nullptr;
+    game.setParallelUpdate(parallel);
+
+    // The viewport fills the terminal, less the borders and status lines.
+    int columns, rows;
+    if (terminal.getSize(columns, rows)) {
+        game.setViewSize(columns, rows - VIEW_FOOTER_ROWS);
     }
-    
+
+    FrameProfiler profiler;
+    profiler.setEnabled(!profilePath.empty());
+    game.setProfiler(&profiler);
+
+    ReplayRecorder* recorder = nullptr;
+    if (!recordPath.empty()) {
+        recorder = new ReplayRecorder(&keyboard, recordPath, seed, game.getWorldWidth(), game.getWorldHeight());
+        if (!recorder->isOpen()) {
+            cerr << "cannot write " << recordPath << endl;
+            delete recorder;
+            delete parallel;
+            return 1;
+        }
+        game.setInput(recorder);
+    }
+
+    SessionRecorder castRecorder;
+    SessionRecorder* cast;
+    if (!openCast(castRecorder, cast, castPath)) {
+        delete recorder;
+        delete parallel;
+        return 1;
+    }
+
+    RenderThread renderThread(cout, renderRate);
+    FixedStepLoop loop(tickRate, renderRate);
+    loop.run(
+        [&]() {
+            profiledTick(game, profiler);
+            if (recorder) recorder->endTick(game);
+        },
+        [&]() { publishFrame(game, profiler, keyboard, renderThread, cast); },
+        [&]() { return !game.isGameOver(); });
+
+    publishFrame(game, profiler, keyboard, renderThread, cast);
+    renderThread.stop();
+    delete recorder;
+    delete parallel;
+    if (cast) cast->stop(cast->elapsedMs());
+    keyboard.stop();
+
     cout << endl << "Thanks for playing!" << endl;
-    system("pause");
+    if (showStats) {
+        const LoopStats& stats = loop.getStats();
+        cout << "Average output: " << renderThread.getPresenter().getAverageFrameBytes() << " bytes/frame" << endl;
+        cout << "Ticks: " << stats.ticks << " | Missed ticks: " << stats.missedTicks
+             << " | Frames: " << stats.frames << endl;
+        cout << "Frame time: mean " << stats.meanFrameMs << " ms | jitter " << stats.jitterMs
+             << " ms | max " << stats.maxFrameMs << " ms" << endl;
+        RenderStats render = renderThread.getStats();
+        cout << "Render thread: published " << render.published << " | presented " << render.presented
+             << " | dropped " << render.dropped << " | duplicated " << render.duplicated
+             << " | draw mean " << render.meanDrawMs << " ms | max " << render.maxDrawMs << " ms" << endl;
+        const LatencyHistogram& latency = renderThread.getLatency();
+        cout << "Input to frame: " << latency.count() << " events | mean " << latency.meanMs()
+             << " ms | p50 " << latency.percentileMs(50) << " ms | p95 " << latency.percentileMs(95)
+             << " ms | p99 " << latency.percentileMs(99) << " ms | max " << latency.maxMs() << " ms" << endl;
+    }
+    if (cast && showStats) printCastStats(*cast, castPath, loop.getStats().meanFrameMs);
+    writeProfile(profiler, profilePath);
+    terminal.pause();
     return 0;
 }
@@ -0,0 +1,233 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include "game.h"
+#include "console.h"
+#include "session_recording.h"
+
+using namespace std;
+
+// Counts what draw() would have sent to the terminal for each frame, the
+// baseline a recording is measured against.
+struct FrameCosts {
+    long long frames;
+    long long keyframes;
+    unsigned long long drawBytes;
+    unsigned long long fullFrameBytes;
+    size_t maxLines;
+};
+
+static FrameCosts measure(CastReader& reader) {
+    FrameCosts costs = { 0, 0, 0, 0, 0 };
+    NullStream sink;
+    ConsoleRenderer presenter;
+
+    reader.seek(0);
+    do {
+        const vector<string>& rows = reader.frameRows();
+        const vector<string>& lines = reader.frameLines();
+        presenter.loadFrame(rows, lines);
+        costs.drawBytes += presenter.draw(sink);
+        costs.fullFrameBytes += rows.size() * (rows.empty() ? 0 : rows[0].size());
+        for (size_t i = 0; i < lines.size(); i++) costs.fullFrameBytes += lines[i].size();
+        costs.maxLines = max(costs.maxLines, lines.size());
+        costs.frames++;
+        if (reader.isKeyframe()) costs.keyframes++;
+    } while (reader.next());
+    return costs;
+}
+
+static int runInfo(CastReader& reader) {
+    FrameCosts costs = measure(reader);
+
+    // Seeks to random points, to show they cost the same anywhere.
+    Rng rng(1);
+    const int seeks = 1000;
+    int64_t span = reader.durationMs() + 1;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < seeks; i++) reader.seek(rng.next() % span);
+    double seekUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / seeks;
+
+    cout << "duration_s=" << reader.durationMs() / 1000.0
+         << " frames=" << costs.frames
+         << " keyframes=" << costs.keyframes
+         << " keyframe_ms=" << reader.getKeyframeMs()
+         << " index_seconds=" << reader.indexSeconds()
+         << " file_bytes=" << reader.fileBytes()
+         << " draw_bytes=" << costs.drawBytes
+         << " full_frame_bytes=" << costs.fullFrameBytes
+         << " file_vs_draw=" << (costs.drawBytes ? (double)reader.fileBytes() / costs.drawBytes : 0)
+         << " seek_us=" << seekUs << endl;
+    return 0;
+}
+
+static void writeJsonString(ostream& out, const string& text) {
+    out << '"';
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c < 0x20 || c >= 0x7F) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// asciicast v2: a JSON header line, then one [seconds, "o", text] line per
+// frame holding exactly the bytes draw() would write.
+static int runExport(CastReader& reader, const string& path, double speed, double fromSeconds) {
+    ofstream out(path.c_str(), ios::binary);
+    if (!out) {
+        cerr << "cannot write " << path << endl;
+        return 1;
+    }
+
+    FrameCosts costs = measure(reader);
+    int64_t fromMs = (int64_t)(fromSeconds * 1000);
+    reader.seek(fromMs);
+    const vector<string>& first = reader.frameRows();
+    int width = first.empty() ? WIDTH : (int)first[0].size();
+    int height = (int)first.size() + 3 + (int)costs.maxLines;
+
+    out << "{\"version\": 2, \"width\": " << width << ", \"height\": " << height
+        << ", \"duration\": " << (reader.durationMs() - fromMs) / 1000.0 / speed << "}\n";
+
+    ConsoleRenderer presenter;
+    ostringstream frame;
+    long long events = 0;
+    do {
+        frame.str("");
+        if (events == 0) frame << "\x1b[2J\x1b[H";
+        presenter.loadFrame(reader.frameRows(), reader.frameLines());
+        presenter.draw(frame);
+
+        double seconds = max<int64_t>(reader.currentMs() - fromMs, 0) / 1000.0 / speed;
+        out << "[" << seconds << ", \"o\", ";
+        writeJsonString(out, frame.str());
+        out << "]\n";
+        events++;
+    } while (reader.next());
+
+    cout << "events=" << events << " bytes=" << out.tellp() << endl;
+    return 0;
+}
+
+// Plays in real time (times `speed`). A/D or the arrows seek 5 seconds,
+// W/S double or halve the speed, SPACE pauses and Q quits.
+static int runPlay(CastReader& reader, double speed, double fromSeconds) {
+    Terminal terminal("Responsive Galaga - Playback");
+    KeyboardInput keyboard;
+    ConsoleRenderer presenter;
+    vector<string> footer;
+
+    typedef chrono::steady_clock Clock;
+    double positionMs = fromSeconds * 1000;
+    reader.seek((int64_t)positionMs);
+    Clock::time_point last = Clock::now();
+    bool paused = false;
+    bool dirty = true;
+
+    while (positionMs <= reader.durationMs()) {
+        unsigned keys = keyboard.poll();
+        if (keys & INPUT_QUIT) break;
+        if (keys & INPUT_SPACE) paused = !paused;
+        if (keys & INPUT_UP) speed = min(speed * 2, 64.0);
+        if (keys & INPUT_DOWN) speed = max(speed / 2, 1.0 / 64);
+        if (keys & (INPUT_LEFT | INPUT_RIGHT)) {
+            positionMs += (keys & INPUT_RIGHT) ? 5000 : -5000;
+            positionMs = max(0.0, min(positionMs, (double)reader.durationMs()));
+            reader.seek((int64_t)positionMs);
+            dirty = true;
+        }
+        if (keys) dirty = true;
+
+        Clock::time_point now = Clock::now();
+        if (!paused) positionMs += chrono::duration<double, milli>(now - last).count() * speed;
+        last = now;
+
+        for (;;) {
+            int64_t next = reader.peekTime();
+            if (next < 0 || next > positionMs) break;
+            reader.next();
+            dirty = true;
+        }
+
+        if (dirty) {
+            footer = reader.frameLines();
+            char status[96];
+            snprintf(status, sizeof(status), " PLAYBACK %.1fs / %.1fs | x%g%s | [A/D] seek [W/S] speed [SPACE] pause [Q] quit",
+                     reader.currentMs() / 1000.0, reader.durationMs() / 1000.0, speed, paused ? " paused" : "");
+            footer.push_back(status);
+            presenter.loadFrame(reader.frameRows(), footer);
+            presenter.draw(cout);
+            dirty = false;
+        }
+        this_thread::sleep_for(chrono::milliseconds(5));
+    }
+    cout << endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "usage: galaga_cast info FILE\n"
+             << "       galaga_cast play FILE [--speed X] [--from SECONDS]\n"
+             << "       galaga_cast export FILE OUT.cast [--speed X] [--from SECONDS]" << endl;
+        return 1;
+    }
+
+    string command = argv[1];
+    string path = argv[2];
+    string exportPath;
+    int first = 3;
+    if (command == "export") {
+        if (argc < 4) {
+            cerr << "export needs an output file" << endl;
+            return 1;
+        }
+        exportPath = argv[3];
+        first = 4;
+    }
+
+    double speed = 1.0;
+    double fromSeconds = 0;
+    for (int i = first; i < argc; i++) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            fromSeconds = atof(argv[++i]);
+        } else {
+            cerr << "unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+    if (speed <= 0) {
+        cerr << "speed must be positive" << endl;
+        return 1;
+    }
+
+    CastReader reader;
+    string error;
+    if (!reader.load(path, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    if (command == "info") return runInfo(reader);
+    if (command == "play") return runPlay(reader, speed, fromSeconds);
+    if (command == "export") return runExport(reader, exportPath, speed, fromSeconds);
+
+    cerr << "unknown command " << command << endl;
+    return 1;
+}
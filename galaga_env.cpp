@@ -0,0 +1,35 @@
+#include "galaga_env.h"
+#include "vector_env.h"
+
+// The C side only ever sees an opaque pointer to one of these.
+struct GalagaEnv {
+    VectorEnv env;
+
+    GalagaEnv(int envCount, int threads) : env(envCount, threads) {}
+};
+
+extern "C" {
+
+GalagaEnv* galaga_env_create(int num_envs, int num_threads) {
+    if (num_envs <= 0 || num_threads < 0) return nullptr;
+    return new GalagaEnv(num_envs, num_threads);
+}
+
+void galaga_env_destroy(GalagaEnv* env) {
+    delete env;
+}
+
+int galaga_env_num_envs(const GalagaEnv* env) {
+    return (int)env->env.size();
+}
+
+void galaga_env_reset(GalagaEnv* env, uint64_t seed, uint8_t* observations) {
+    env->env.reset(seed, observations);
+}
+
+void galaga_env_step(GalagaEnv* env, const int32_t* actions, uint8_t* observations,
+                     float* rewards, uint8_t* dones) {
+    env->env.step(actions, observations, rewards, dones);
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef GALAGA_ENV_H
+#define GALAGA_ENV_H
+
+/*
+ * C interface to a batch of headless games for reinforcement learning.
+ * Build the shared library with
+ *
+ *   g++ -std=c++11 -O2 -pthread -shared -fPIC galaga_env.cpp -o libgalaga_env.so
+ *
+ * Every environment writes one fixed-size observation record into the
+ * caller's buffer, back to back, so a batch of N is one contiguous block of
+ * N * GALAGA_ENV_OBSERVATION_BYTES bytes that can be wrapped as an array
+ * without copying. A record is:
+ *
+ *   offset 0                          uint8 grid[24][80], the playfield as
+ *                                     ASCII (' ' empty, '<A>' player, ...)
+ *   offset GALAGA_ENV_FEATURE_OFFSET  float features[GALAGA_ENV_FEATURE_COUNT],
+ *                                     indexed by GalagaEnvFeature
+ *
+ * step() repeats each action for one tick, rewards the score gained, and
+ * sets done when the game ends. A finished environment restarts at once
+ * with seed + num_envs, so the observation it returns is the first one of
+ * its next episode and its seeds never collide with another environment's.
+ * Once the games have warmed up, step() only allocates when an episode
+ * restarts.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    GALAGA_ENV_GRID_WIDTH = 80,
+    GALAGA_ENV_GRID_HEIGHT = 24,
+    GALAGA_ENV_GRID_BYTES = GALAGA_ENV_GRID_WIDTH * GALAGA_ENV_GRID_HEIGHT,
+    GALAGA_ENV_FEATURE_OFFSET = GALAGA_ENV_GRID_BYTES
+};
+
+typedef enum {
+    GALAGA_FEATURE_PLAYER_X,
+    GALAGA_FEATURE_LIVES,
+    GALAGA_FEATURE_WAVE,
+    GALAGA_FEATURE_SCORE,
+    GALAGA_FEATURE_ENEMIES_ALIVE,
+    GALAGA_FEATURE_BOSSES_ALIVE,
+    GALAGA_FEATURE_GIANT_BOSS_HEALTH,   /* 0 when there is none */
+    GALAGA_FEATURE_TICK,
+    GALAGA_ENV_FEATURE_COUNT
+} GalagaEnvFeature;
+
+enum {
+    GALAGA_ENV_OBSERVATION_BYTES = GALAGA_ENV_FEATURE_OFFSET + GALAGA_ENV_FEATURE_COUNT * 4
+};
+
+typedef enum {
+    GALAGA_ACTION_NOOP,
+    GALAGA_ACTION_LEFT,
+    GALAGA_ACTION_RIGHT,
+    GALAGA_ACTION_FIRE,
+    GALAGA_ACTION_LEFT_FIRE,
+    GALAGA_ACTION_RIGHT_FIRE,
+    GALAGA_ACTION_COUNT
+} GalagaAction;
+
+typedef struct GalagaEnv GalagaEnv;
+
+/* num_threads 0 uses every core; 1 steps on the calling thread. */
+GalagaEnv* galaga_env_create(int num_envs, int num_threads);
+void galaga_env_destroy(GalagaEnv* env);
+
+int galaga_env_num_envs(const GalagaEnv* env);
+
+/* Restarts environment i with seed + i and writes every observation. */
+void galaga_env_reset(GalagaEnv* env, uint64_t seed, uint8_t* observations);
+
+/* actions[num_envs] in, observations, rewards[num_envs] and dones[num_envs]
+   out. Actions outside GalagaAction count as NOOP. */
+void galaga_env_step(GalagaEnv* env, const int32_t* actions, uint8_t* observations,
+                     float* rewards, uint8_t* dones);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,360 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <cstring>
+#include <cstdlib>
+#include "game_server.h"
+#include "rng.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static GameServer* activeServer = nullptr;
+
+static void stopServer(int) {
+    if (activeServer) activeServer->stop();
+}
+
+static void printLateness(const LatencyHistogram& lateness) {
+    cout << " lateness_mean_ms=" << lateness.meanMs()
+         << " lateness_p50_ms=" << lateness.percentileMs(50)
+         << " lateness_p99_ms=" << lateness.percentileMs(99)
+         << " lateness_max_ms=" << lateness.maxMs();
+}
+
+static void printSession(const GameSession& session) {
+    const SessionStats& stats = session.getStats();
+    cout << "session=" << session.getId() << " closed ticks=" << stats.ticks << " frames=" << stats.frames;
+    printLateness(stats.lateness);
+    cout << " late_ticks=" << stats.lateTicks << " missed_ticks=" << stats.missedTicks
+         << " dropped_frames=" << stats.droppedFrames << " bytes_in=" << stats.bytesIn
+         << " bytes_out=" << stats.bytesOut << " score=" << session.getGame().getScore() << endl;
+}
+
+static void printTotals(const GameServer& server, const SessionStats& totals) {
+    cout << "sessions=" << server.sessionCount() << " accepted=" << server.acceptedCount()
+         << " rejected=" << server.rejectedCount() << " ticks=" << totals.ticks;
+    printLateness(totals.lateness);
+    cout << " late_ticks=" << totals.lateTicks << " missed_ticks=" << totals.missedTicks
+         << " dropped_frames=" << totals.droppedFrames << " bytes_out=" << totals.bytesOut << endl;
+}
+
+// Lets a benchmark open thousands of sockets at once.
+static void raiseDescriptorLimit() {
+#ifndef _WIN32
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+// Simulated players on loopback for the capacity benchmark. Each one hits
+// ENTER to leave the title screen, then taps a random move or fire key
+// every few frames the way a person at a keyboard would, and reads and
+// throws away everything the server sends.
+class LoopbackClients {
+private:
+    struct Client {
+        SocketHandle fd;
+        Clock::time_point nextKey;
+    };
+
+    vector<Client> clients;
+#ifdef _WIN32
+    vector<WSAPOLLFD> polls;
+#else
+    vector<pollfd> polls;
+#endif
+    Rng rng;
+    vector<char> buffer;
+    unsigned long long bytesRead;
+
+    Clock::duration keyGap() {
+        return chrono::milliseconds(50 + rng.nextInt(100));
+    }
+
+public:
+    explicit LoopbackClients(uint64_t seed) : rng(seed), buffer(64 * 1024), bytesRead(0) {}
+
+    ~LoopbackClients() {
+        for (size_t i = 0; i < clients.size(); i++) closeSocket(clients[i].fd);
+    }
+
+    LoopbackClients(const LoopbackClients&) = delete;
+    LoopbackClients& operator=(const LoopbackClients&) = delete;
+
+    bool connect(uint16_t port) {
+        Client client;
+        client.fd = connectLoopback(port);
+        if (client.fd == NO_SOCKET) return false;
+        client.nextKey = Clock::now() + keyGap();
+        ::send(client.fd, "\r", 1, 0);
+        clients.push_back(client);
+
+        polls.resize(clients.size());
+        polls.back().fd = client.fd;
+        polls.back().events = POLLIN;
+        return true;
+    }
+
+    // Wait (up to `timeoutMs`) for output, drain it, and send whatever keys
+    // are due.
+    void pump(int timeoutMs) {
+        if (clients.empty()) return;
+#ifdef _WIN32
+        int ready = WSAPoll(polls.data(), (ULONG)polls.size(), timeoutMs);
+#else
+        int ready = poll(polls.data(), polls.size(), timeoutMs);
+#endif
+        for (size_t i = 0; ready > 0 && i < polls.size(); i++) {
+            if (!polls[i].revents) continue;
+            ready--;
+            for (;;) {
+                int n = (int)recv(clients[i].fd, buffer.data(), (int)buffer.size(), 0);
+                if (n <= 0) break;
+                bytesRead += n;
+            }
+        }
+
+        static const char keys[] = { 'a', 'd', ' ', 'a', 'd' };
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (clients[i].nextKey > now) continue;
+            char key = keys[rng.nextInt(sizeof(keys))];
+            ::send(clients[i].fd, &key, 1, 0);
+            clients[i].nextKey = now + keyGap();
+        }
+    }
+
+    size_t size() const { return clients.size(); }
+    unsigned long long getBytesRead() const { return bytesRead; }
+};
+
+struct CapacityOptions {
+    int startSessions;
+    int maxSessions;
+    double seconds;
+    ServerConfig server;
+};
+
+struct CapacityResult {
+    int sessions;
+    int connected;
+    double seconds;
+    SessionStats totals;
+    double ticksPerSession;     // per second, against the configured tick rate
+    bool sustained;
+};
+
+// One run: a fresh server on an ephemeral loopback port, `sessions`
+// clients, a settling second, then `seconds` of measurement.
+static CapacityResult runCapacityStep(int sessions, const CapacityOptions& options) {
+    CapacityResult result;
+    result.sessions = sessions;
+    result.connected = 0;
+    result.seconds = 0;
+    result.ticksPerSession = 0;
+    result.sustained = false;
+
+    SocketListener listener;
+    if (!listener.listenTcp(0, false)) {
+        cerr << "cannot listen on loopback" << endl;
+        return result;
+    }
+    ServerConfig config = options.server;
+    config.maxSessions = sessions;
+    GameServer server(config, listener);
+    thread scheduler([&server]() { server.run(); });
+
+    LoopbackClients clients(config.seed);
+    for (int i = 0; i < sessions; i++) {
+        if (!clients.connect(listener.localPort())) break;
+        if (i % 64 == 63) clients.pump(0);
+    }
+    result.connected = (int)clients.size();
+
+    Clock::time_point settle = Clock::now() + chrono::seconds(1);
+    while (Clock::now() < settle) clients.pump(2);
+
+    server.requestStatsReset();
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.seconds));
+    while (Clock::now() < end) clients.pump(2);
+    server.stop();
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+    scheduler.join();
+
+    result.totals = server.totals();
+    double expected = result.connected * result.seconds * config.tickRate;
+    result.ticksPerSession = result.connected && result.seconds > 0
+        ? result.totals.ticks / (double)result.connected / result.seconds : 0;
+    double intervalMs = 1000.0 / config.tickRate;
+    result.sustained = result.connected == sessions &&
+                       result.totals.lateness.percentileMs(99) <= intervalMs &&
+                       result.totals.missedTicks <= expected * 0.001;
+    return result;
+}
+
+static void printCapacityStep(const CapacityResult& result, size_t threads) {
+    const SessionStats& totals = result.totals;
+    cout << "sessions=" << result.sessions << " connected=" << result.connected << " threads=" << threads
+         << " seconds=" << result.seconds << " ticks_per_session_per_sec=" << result.ticksPerSession;
+    printLateness(totals.lateness);
+    cout << " late_ticks=" << totals.lateTicks << " missed_ticks=" << totals.missedTicks
+         << " dropped_frames=" << totals.droppedFrames
+         << " out_kb_per_session_per_sec="
+         << (result.connected && result.seconds > 0 ? totals.bytesOut / 1024.0 / result.connected / result.seconds : 0)
+         << " sustained=" << (result.sustained ? "yes" : "no") << endl;
+}
+
+// Doubles the session count, with the last step landing on the maximum,
+// until a step can't keep up (or halves it when even the first step
+// can't), then narrows the gap between the last good and the first bad
+// count by bisection. If the maximum itself keeps up, the real limit is
+// somewhere above it and the result is only a lower bound.
+static int runCapacityBench(const CapacityOptions& options) {
+    raiseDescriptorLimit();
+    size_t threads = options.server.threads > 0 ? (size_t)options.server.threads : max(1u, thread::hardware_concurrency());
+    if (options.server.threads == 1) threads = 1;
+    unsigned cores = max(1u, thread::hardware_concurrency());
+
+    int good = 0;
+    int bad = 0;
+    for (int sessions = options.startSessions;;
+         sessions = sessions > options.maxSessions / 2 ? options.maxSessions : sessions * 2) {
+        CapacityResult result = runCapacityStep(sessions, options);
+        printCapacityStep(result, threads);
+        if (!result.sustained) {
+            bad = sessions;
+            break;
+        }
+        good = sessions;
+        if (sessions >= options.maxSessions) break;
+    }
+    for (int sessions = bad / 2; good == 0 && sessions > 0; sessions /= 2) {
+        CapacityResult result = runCapacityStep(sessions, options);
+        printCapacityStep(result, threads);
+        if (result.sustained) {
+            good = sessions;
+        } else {
+            bad = sessions;
+        }
+    }
+    for (int step = 0; step < 3 && bad > good + 1 && good > 0; step++) {
+        int sessions = (good + bad) / 2;
+        CapacityResult result = runCapacityStep(sessions, options);
+        printCapacityStep(result, threads);
+        if (result.sustained) {
+            good = sessions;
+        } else {
+            bad = sessions;
+        }
+    }
+
+    cout << "max_sustained_sessions=" << good << " limit=" << (bad > 0 ? "measured" : "lower_bound")
+         << " tick_rate=" << options.server.tickRate << " threads=" << threads << " cores=" << cores
+         << " sessions_per_core=" << (double)good / cores << endl;
+    return good > 0 ? 0 : 1;
+}
+
+static int runServer(const ServerConfig& config, uint16_t port, bool anyAddress, const string& unixPath,
+                     double reportSeconds) {
+    SocketListener listener;
+#ifndef _WIN32
+    if (!unixPath.empty()) {
+        if (!listener.listenUnix(unixPath)) {
+            cerr << "cannot listen on " << unixPath << endl;
+            return 1;
+        }
+    } else
+#endif
+    if (!listener.listenTcp(port, anyAddress)) {
+        cerr << "cannot listen on port " << port << endl;
+        return 1;
+    }
+    raiseDescriptorLimit();
+
+    GameServer server(config, listener);
+    server.setOnClose(printSession);
+    activeServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+
+    cout << "listening on " << (unixPath.empty() ? "port " + to_string(listener.localPort()) : unixPath)
+         << " tick_rate=" << config.tickRate << " threads=" << server.threadCount()
+         << " max_sessions=" << config.maxSessions << endl;
+    server.run([&server]() { printTotals(server, server.totals()); }, reportSeconds);
+
+    activeServer = nullptr;
+    printTotals(server, server.totals());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    ServerConfig config;
+    int port = 7777;
+    bool anyAddress = false;
+    string unixPath;
+    double reportSeconds = 10;
+    CapacityOptions capacity;
+    capacity.startSessions = 64;
+    capacity.maxSessions = 0;
+    capacity.seconds = 5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bind-any") == 0) {
+            anyAddress = true;
+#ifndef _WIN32
+        } else if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc) {
+            unixPath = argv[++i];
+#endif
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.threads = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            config.tickRate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-sessions") == 0 && i + 1 < argc) {
+            config.maxSessions = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--telnet") == 0) {
+            config.telnet = true;
+        } else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            reportSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--capacity-bench") == 0 && i + 1 < argc) {
+            capacity.maxSessions = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) {
+            capacity.startSessions = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            capacity.seconds = max(0.1, atof(argv[++i]));
+        } else {
+            cerr << "usage: galaga_server [--port N | --unix PATH] [--bind-any] [--threads N] [--tick-rate HZ]\n"
+                 << "                     [--max-sessions N] [--seed N] [--telnet] [--report SECONDS]\n"
+                 << "       galaga_server --capacity-bench MAX_SESSIONS [--start N] [--seconds S]\n"
+                 << "                     [--threads N] [--tick-rate HZ] [--seed N]" << endl;
+            return 1;
+        }
+    }
+
+    if (capacity.maxSessions > 0) {
+        capacity.server = config;
+        capacity.startSessions = min(capacity.startSessions, capacity.maxSessions);
+        return runCapacityBench(capacity);
+    }
+    return runServer(config, (uint16_t)port, anyAddress, unixPath, reportSeconds);
+}
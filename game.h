@@ -0,0 +1,1316 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include "rng.h"
+#include "broadphase.h"
+#include "bitboard.h"
+#include "entity_store.h"
+#include "parallel_update.h"
+#include "snapshot.h"
+#include "profiler.h"
+#include "sprites.h"
+
+using namespace std;
+
+// The classic arena: the default world and viewport size, and the area in
+// the bottom middle of a bigger world where waves are laid out.
+const int WIDTH = 80;
+const int HEIGHT = 24;
+const int PLAYER_POS = HEIGHT - 2;
+
+// Largest world along either axis. Sizes come from the command line,
+// replay files and the co-op host, and each one is checked against this
+// before a game allocates its grids and frame rows.
+const int MAX_WORLD_SIZE = 4096;
+
+inline bool worldSizeAllowed(long long width, long long height) {
+    return width > 0 && height > 0 && width <= MAX_WORLD_SIZE && height <= MAX_WORLD_SIZE;
+}
+
+enum InputBits {
+    INPUT_LEFT      = 1 << 0,
+    INPUT_RIGHT     = 1 << 1,
+    INPUT_UP        = 1 << 2,
+    INPUT_DOWN      = 1 << 3,
+    INPUT_SPACE     = 1 << 4,
+    INPUT_ENTER     = 1 << 5,
+    INPUT_RESTART   = 1 << 6,
+    INPUT_MECHANICS = 1 << 7,
+    INPUT_QUIT      = 1 << 8,
+    INPUT_PROFILER  = 1 << 9
+};
+
+// Anything that can tell the game which keys were pressed since the last
+// tick: the keyboard, a script, a replay file or a bot.
+class InputSource {
+public:
+    virtual ~InputSource() {}
+    virtual unsigned poll() = 0;
+};
+
+class NullInput : public InputSource {
+public:
+    unsigned poll() { return 0; }
+};
+
+// Presses ENTER on the title screen, then wanders and fires at random.
+// Never sends quit or restart, so a headless run only ends on game over.
+class RandomInput : public InputSource {
+private:
+    Rng rng;
+    unsigned held;
+    int holdTicks;
+
+public:
+    explicit RandomInput(uint64_t seed) : rng(seed), held(0), holdTicks(0) {}
+
+    unsigned poll() {
+        if (holdTicks <= 0) {
+            int roll = rng.nextInt(3);
+            held = roll == 0 ? INPUT_LEFT : (roll == 1 ? INPUT_RIGHT : 0);
+            holdTicks = 5 + rng.nextInt(20);
+        }
+        holdTicks--;
+
+        unsigned keys = held | INPUT_ENTER;
+        if (rng.nextInt(4) == 0) keys |= INPUT_SPACE;
+        return keys;
+    }
+};
+
+// Discards everything written to it; lets the renderer run with no terminal.
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize n) { return n; }
+};
+
+class NullStream : public ostream {
+private:
+    NullBuffer sink;
+
+public:
+    NullStream() : ostream(&sink) {}
+};
+
+// Keeps the frame the terminal is currently showing next to the one being
+// composed, and on draw() sends only the cells that changed: one ANSI cursor
+// move per dirty span followed by the new characters, all in a single write.
+// Status lines below the playfield are diffed line by line the same way.
+//
+// The buffer is one viewport, not the world. Drawing calls take world
+// coordinates and subtract the origin set by setOrigin(), so anything off
+// the viewport is clipped before it touches the buffer.
+class ConsoleRenderer {
+private:
+    int width, height;
+    int originX, originY;
+    vector<string> buffer;
+    vector<string> front;
+    // Footer lines. Both vectors only grow; the first lineCount (or
+    // frontLineCount) entries are live, so refilling them every frame
+    // reuses the strings instead of allocating new ones.
+    vector<string> lines;
+    vector<string> frontLines;
+    size_t lineCount;
+    size_t frontLineCount;
+    bool frontValid;
+    string frameOut;
+    size_t lastFrameBytes;
+    unsigned long long totalBytes;
+    unsigned long long framesDrawn;
+
+    void moveTo(int row, int col) {
+        char seq[24];
+        int n = snprintf(seq, sizeof(seq), "\x1b[%d;%dH", row, col);
+        frameOut.append(seq, n);
+    }
+
+    void moveRight(int count) {
+        char seq[16];
+        int n = snprintf(seq, sizeof(seq), "\x1b[%dC", count);
+        frameOut.append(seq, n);
+    }
+
+    // Footer slots are made up front and each starts with room for a wide
+    // status line, so a longer hint, an extra status field or the game over
+    // lines showing up later don't allocate mid-game.
+    enum { FOOTER_LINES_RESERVE = 8, FOOTER_LINE_RESERVE = 2 * WIDTH };
+
+    static void growLines(vector<string>& slots, size_t count) {
+        while (slots.size() < count) {
+            slots.push_back(string());
+            slots.back().reserve(FOOTER_LINE_RESERVE);
+        }
+    }
+
+    void diffRow(int y) {
+        const string& next = buffer[y];
+        string& shown = front[y];
+        int screenRow = y + 2;
+        int x = 0;
+        int cursor = -1;
+
+        while (x < width) {
+            if (next[x] == shown[x]) {
+                x++;
+                continue;
+            }
+
+            int spanEnd = x + 1;
+            while (spanEnd < width && next[spanEnd] != shown[spanEnd]) spanEnd++;
+
+            if (cursor < 0) {
+                moveTo(screenRow, x + 1);
+            } else if (x - cursor <= 4) {
+                frameOut.append(next, cursor, x - cursor);
+            } else {
+                moveRight(x - cursor);
+            }
+
+            frameOut.append(next, x, spanEnd - x);
+            cursor = spanEnd;
+            x = spanEnd;
+        }
+
+        shown = next;
+    }
+
+public:
+    explicit ConsoleRenderer(int width = WIDTH, int height = HEIGHT) :
+        width(0), height(0), originX(0), originY(0), lineCount(0), frontLineCount(0), frontValid(false),
+        lastFrameBytes(0), totalBytes(0), framesDrawn(0) {
+        resize(width, height);
+        frameOut.reserve(8192);
+        growLines(lines, FOOTER_LINES_RESERVE);
+        growLines(frontLines, FOOTER_LINES_RESERVE);
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Changes the viewport size; the next draw() repaints everything.
+    void resize(int newWidth, int newHeight) {
+        width = max(newWidth, 1);
+        height = max(newHeight, 1);
+        buffer.assign(height, string(width, ' '));
+        front.assign(height, string(width, '\0'));
+        frontValid = false;
+    }
+
+    // The world cell that lands on the viewport's top-left corner.
+    void setOrigin(int x, int y) {
+        originX = x;
+        originY = y;
+    }
+
+    void clear() {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                buffer[y][x] = ' ';
+            }
+        }
+        lineCount = 0;
+    }
+
+    void setChar(int x, int y, char c) {
+        x -= originX;
+        y -= originY;
+        if (x >= 0 && x < width && y >= 0 && y < height) {
+            buffer[y][x] = c;
+        }
+    }
+
+    // Draws a sprite with its origin on (x, y). A sprite that fits on the
+    // field (the usual case) is checked once and its spans copied straight
+    // in; only sprites hanging over an edge clip span by span.
+    void blit(const SpriteView& sprite, int x, int y) {
+        int left = x - originX - sprite.originX;
+        int top = y - originY - sprite.originY;
+
+        if (left >= 0 && top >= 0 && left + sprite.width <= width && top + sprite.height <= height) {
+            for (int i = 0; i < sprite.spanCount; i++) {
+                const SpriteSpan& span = sprite.spans[i];
+                char* out = &buffer[top + span.y][left + span.x];
+                const char* glyphs = sprite.glyphs + span.glyph;
+                for (int c = 0; c < span.length; c++) out[c] = glyphs[c];
+            }
+            return;
+        }
+
+        for (int i = 0; i < sprite.spanCount; i++) {
+            const SpriteSpan& span = sprite.spans[i];
+            int row = top + span.y;
+            if (row < 0 || row >= height) continue;
+            int start = left + span.x;
+            int from = max(start, 0);
+            int to = min(start + span.length, width);
+            const char* glyphs = sprite.glyphs + span.glyph - start;
+            for (int c = from; c < to; c++) buffer[row][c] = glyphs[c];
+        }
+    }
+
+    void blit(const SpriteAtlas& atlas, int id, int x, int y) {
+        blit(atlas.view(id), x, y);
+    }
+
+    // `count` copies of c from (x, y) rightwards, clipped once.
+    void fill(int x, int y, char c, int count) {
+        x -= originX;
+        y -= originY;
+        if (y < 0 || y >= height) return;
+        int from = max(x, 0);
+        int to = min(x + count, width);
+        if (from < to) memset(&buffer[y][from], c, to - from);
+    }
+
+    void text(int x, int y, const char* text, int length) {
+        x -= originX;
+        y -= originY;
+        if (y < 0 || y >= height) return;
+        int from = max(x, 0);
+        int to = min(x + length, width);
+        if (from < to) memcpy(&buffer[y][from], text + (from - x), to - from);
+    }
+
+    void addLine(const char* text, size_t length) {
+        growLines(lines, lineCount + 1);
+        lines[lineCount++].assign(text, length);
+    }
+
+    void addLine(const char* text) { addLine(text, strlen(text)); }
+    void addLine(const string& text) { addLine(text.data(), text.size()); }
+
+    const string& row(int y) const { return buffer[y]; }
+
+    // Copies out the composed frame (field rows and footer lines), e.g. to
+    // hand it to another thread, and loads one back in for draw(). Strings
+    // are assigned in place, so once warmed up neither allocates.
+    void saveFrame(vector<string>& rows, vector<string>& footer) const {
+        rows.resize(height);
+        for (int y = 0; y < height; y++) rows[y] = buffer[y];
+        footer.resize(lineCount);
+        for (size_t i = 0; i < lineCount; i++) footer[i] = lines[i];
+    }
+
+    // The same into footer slots that only grow, like `lines`: the first
+    // `footerCount` are live. Shrinking a vector of strings frees them, so
+    // a footer that comes and goes would allocate on every return.
+    void saveFrame(vector<string>& rows, vector<string>& footer, size_t& footerCount) const {
+        rows.resize(height);
+        for (int y = 0; y < height; y++) rows[y] = buffer[y];
+        if (footer.size() < lineCount) footer.resize(lineCount);
+        for (size_t i = 0; i < lineCount; i++) footer[i] = lines[i];
+        footerCount = lineCount;
+    }
+
+    // A frame of a different size resizes the viewport to match.
+    void loadFrame(const vector<string>& rows, const vector<string>& footer) {
+        if (rows.empty()) return;
+        if ((int)rows.size() != height || (int)rows[0].size() != width) {
+            resize((int)rows[0].size(), (int)rows.size());
+        }
+        for (int y = 0; y < height; y++) buffer[y] = rows[y];
+        lineCount = 0;
+        for (size_t i = 0; i < footer.size(); i++) addLine(footer[i]);
+    }
+
+    // Forget what the terminal shows, e.g. after it was cleared or resized,
+    // so the next draw() repaints everything.
+    void invalidate() {
+        frontValid = false;
+        for (int y = 0; y < height; y++) {
+            front[y].assign(width, '\0');
+        }
+        frontLineCount = 0;
+    }
+
+    size_t draw(ostream& out) {
+        frameOut.clear();
+
+        if (!frontValid) {
+            moveTo(1, 1);
+            frameOut.append(width, '=');
+            moveTo(height + 2, 1);
+            frameOut.append(width, '=');
+        }
+
+        for (int y = 0; y < height; y++) {
+            diffRow(y);
+        }
+
+        size_t shownCount = max(lineCount, frontLineCount);
+        static const string blank;
+        for (size_t i = 0; i < shownCount; i++) {
+            const string& text = i < lineCount ? lines[i] : blank;
+            if (frontValid && i < frontLineCount && frontLines[i] == text) continue;
+
+            moveTo(height + 3 + (int)i, 1);
+            frameOut += text;
+            frameOut += "\x1b[K";
+        }
+        growLines(frontLines, lineCount);
+        for (size_t i = 0; i < lineCount; i++) frontLines[i] = lines[i];
+        frontLineCount = lineCount;
+
+        if (!frameOut.empty()) {
+            // Park the cursor below everything so anything printed after the
+            // game ends up underneath the frame.
+            moveTo(height + 3 + (int)lineCount, 1);
+            out.write(frameOut.data(), frameOut.size());
+            out.flush();
+        }
+
+        frontValid = true;
+        lastFrameBytes = frameOut.size();
+        totalBytes += lastFrameBytes;
+        framesDrawn++;
+        return lastFrameBytes;
+    }
+
+    size_t getLastFrameBytes() const { return lastFrameBytes; }
+    double getAverageFrameBytes() const {
+        return framesDrawn > 0 ? (double)totalBytes / framesDrawn : 0.0;
+    }
+};
+
+// FNV-1a over whatever gets fed in; used to fingerprint game state.
+class StateHash {
+private:
+    uint64_t hash;
+
+public:
+    StateHash() : hash(0xCBF29CE484222325ULL) {}
+
+    void add(const void* data, size_t size) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ULL;
+        }
+    }
+
+    void add(int64_t value) { add(&value, sizeof(value)); }
+
+    template <typename T>
+    void add(const vector<T>& values, size_t count) {
+        add((int64_t)count);
+        if (count > 0) add(values.data(), count * sizeof(T));
+    }
+
+    uint64_t value() const { return hash; }
+};
+
+// The whole game minus the platform: no console, no keyboard, no sleeping.
+// Input arrives through an InputSource and all randomness comes from the
+// game's own seeded Rng, so it runs the same on any OS and as fast as the
+// CPU allows when nobody is watching.
+class ResponsiveGame {
+private:
+    // World size is fixed per game. Waves are laid out in the classic
+    // arena at (arenaX, arenaY); the viewport follows the player.
+    int worldWidth, worldHeight;
+    int arenaX, arenaY;
+    int playerY;
+    ConsoleRenderer renderer;
+    InputSource* input;
+    FrameProfiler* profiler;
+    ParallelUpdate* parallel;
+    Rng rng;
+    int playerX;
+    // Co-op only: the second ship shares the field, the score and the lives.
+    bool coop;
+    int partnerX;
+    int partnerCooldown;
+    int viewShip;
+    int score;
+    int lives;
+    int wave;
+    bool gameOver;
+    bool showTitleScreen;
+    bool showMechanics;
+    int titleSelection;
+
+    BulletStore bullets;
+    EnemyStore enemies;
+    UniformGrid collisionGrid;
+    vector<GridBox> enemyBoxes;
+    Bitboard enemyCells;
+    Bitboard shotCells;
+
+    bool leftPressed;
+    bool rightPressed;
+    bool spacePressed;
+    bool upPressed;
+    bool downPressed;
+    bool enterPressed;
+
+    int frameCount;
+    int shootCooldown;
+    int mechanicsDisplayTime;
+    bool giantBossSpawnedThisWave;
+    int giantBossDefeatTimer;
+    int bossWarningTime;
+    GameStats stats;
+    vector<EnemyListener*> enemyListeners;
+
+public:
+    // Worlds smaller than the classic arena are grown to it.
+    ResponsiveGame(InputSource* input = nullptr, uint64_t seed = 1,
+                   int width = WIDTH, int height = HEIGHT) :
+                      worldWidth(max(width, WIDTH)), worldHeight(max(height, HEIGHT)),
+                      arenaX((worldWidth - WIDTH) / 2), arenaY(worldHeight - HEIGHT),
+                      playerY(worldHeight - 2),
+                      input(input), profiler(nullptr), parallel(nullptr), rng(seed),
+                      playerX(worldWidth / 2), coop(false), partnerX(worldWidth / 2),
+                      partnerCooldown(0), viewShip(0), score(0), lives(10), wave(1), gameOver(false),
+                      showTitleScreen(true), showMechanics(false), titleSelection(0),
+                      bullets(worldWidth, worldHeight), enemies(worldWidth, worldHeight),
+                      collisionGrid(worldWidth, worldHeight),
+                      enemyCells(worldWidth, worldHeight), shotCells(worldWidth, worldHeight),
+                      leftPressed(false), rightPressed(false), spacePressed(false),
+                      upPressed(false), downPressed(false), enterPressed(false),
+                      frameCount(0), shootCooldown(0), mechanicsDisplayTime(0),
+                      giantBossSpawnedThisWave(false), giantBossDefeatTimer(0),
+                      bossWarningTime(0) {
+        memset(&stats, 0, sizeof(stats));
+        enemyBoxes.reserve(ENEMY_KIND_COUNT * ENEMY_LANE_RESERVE);
+        collisionGrid.reserve(enemyBoxes.capacity(), 4);
+        createEnemyWave();
+    }
+
+    void setInput(InputSource* source) { input = source; }
+
+    int getWorldWidth() const { return worldWidth; }
+    int getWorldHeight() const { return worldHeight; }
+
+    // Adds the second ship. Both ships start either side of the middle;
+    // call before the first tick, on every peer of a co-op session.
+    void enableCoop() {
+        coop = true;
+        placeShips();
+    }
+
+    // Which ship the viewport follows: 0 for the first, 1 for the partner.
+    void setViewShip(int ship) { viewShip = ship; }
+
+    void placeShips() {
+        playerX = coop ? worldWidth / 2 - 4 : worldWidth / 2;
+        partnerX = worldWidth / 2 + 4;
+        partnerCooldown = 0;
+    }
+
+    // Sizes the viewport, e.g. to the terminal. It never exceeds the world.
+    void setViewSize(int width, int height) {
+        renderer.resize(min(width, worldWidth), min(height, worldHeight));
+    }
+
+    // Top-left world cell of the viewport: centred on the player across,
+    // bottom of the world down, clamped so it never shows past an edge.
+    int getViewX() const {
+        int x = (coop && viewShip == 1 ? partnerX : playerX) - renderer.getWidth() / 2;
+        return max(0, min(x, worldWidth - renderer.getWidth()));
+    }
+
+    int getViewY() const { return worldHeight - renderer.getHeight(); }
+
+    // Optional; the profiler only observes and never changes the simulation.
+    void setProfiler(FrameProfiler* frameProfiler) { profiler = frameProfiler; }
+
+    // Optional; splits the entity update of big waves over its threads
+    // without changing a single bit of the outcome. A copied game shares it,
+    // so only one of them may be updated at a time.
+    void setParallelUpdate(ParallelUpdate* update) { parallel = update; }
+
+    // Listeners hear every spawn and kill after the game has scored it.
+    // Like the profiler they only observe, and a copied game shares them.
+    void subscribe(EnemyListener* listener) { enemyListeners.push_back(listener); }
+
+    void unsubscribe(EnemyListener* listener) {
+        enemyListeners.erase(remove(enemyListeners.begin(), enemyListeners.end(), listener),
+                             enemyListeners.end());
+    }
+
+    // Drains the registry's event queue: kills are scored here, then every
+    // event goes to the listeners in the order it happened.
+    void publishEnemyEvents() {
+        const vector<EnemyEvent>& events = enemies.pendingEvents();
+        for (size_t i = 0; i < events.size(); i++) {
+            const EnemyEvent& event = events[i];
+            if (event.type == ENEMY_KILLED) {
+                score += enemyScore(event.kind);
+                stats.kills[event.kind]++;
+            }
+            for (size_t l = 0; l < enemyListeners.size(); l++) enemyListeners[l]->onEnemyEvent(event);
+        }
+        enemies.clearEvents();
+    }
+
+    void createEnemyWave() {
+        enemies.clear();
+        giantBossSpawnedThisWave = false;
+
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 3; j++) {
+                enemies.spawn(ENEMY_REGULAR, arenaX + 10 + i * 8, arenaY + 3 + j * 2, (j % 2 == 0) ? 1 : -1);
+            }
+        }
+    }
+
+    void spawnRegularBoss() {
+        enemies.spawn(ENEMY_BOSS, worldWidth / 2, arenaY + 2);
+    }
+
+    void spawnGiantBoss() {
+        enemies.spawn(ENEMY_GIANT, worldWidth / 2, arenaY + 3);
+        giantBossSpawnedThisWave = true;
+        bossWarningTime = 120;
+    }
+
+    // The giant boss's health gauge, one cell per starting hit point, and
+    // its label above that.
+    void drawBossGauge(int x, int y, int health, int maxHealth) {
+        int gaugeWidth = maxHealth;
+        int segment = max(1, gaugeWidth * health / maxHealth);
+        int left = x - gaugeWidth / 2;
+        renderer.fill(left, y - 1, '=', segment);
+        renderer.fill(left + segment, y - 1, ' ', gaugeWidth - segment);
+        renderer.text(x - 2, y - 2, "BOSS", 4);
+    }
+
+    void updateInput() {
+        applyInput(input ? input->poll() : 0);
+    }
+
+    void applyInput(unsigned keys) {
+        leftPressed = (keys & INPUT_LEFT) != 0;
+        rightPressed = (keys & INPUT_RIGHT) != 0;
+        upPressed = (keys & INPUT_UP) != 0;
+        downPressed = (keys & INPUT_DOWN) != 0;
+        spacePressed = (keys & INPUT_SPACE) != 0;
+        enterPressed = (keys & INPUT_ENTER) != 0;
+
+        if (keys & INPUT_QUIT) gameOver = true;
+        if (keys & INPUT_RESTART) resetGame();
+        if (keys & INPUT_MECHANICS) toggleMechanics();
+        if ((keys & INPUT_PROFILER) && profiler) profiler->toggleOverlay();
+
+        if (showTitleScreen) {
+            if (upPressed) titleSelection = (titleSelection - 1 + 2) % 2;
+            if (downPressed) titleSelection = (titleSelection + 1) % 2;
+            if (enterPressed) {
+                if (titleSelection == 0) {
+                    showTitleScreen = false;
+                } else {
+                    gameOver = true;
+                }
+            }
+            return;
+        }
+
+        if (rightPressed && leftPressed) {
+            if (playerX < worldWidth / 2) {
+                leftPressed = false;
+            } else {
+                rightPressed = false;
+            }
+        }
+
+        steerShip(playerX, shootCooldown, leftPressed, rightPressed, spacePressed);
+
+        if (mechanicsDisplayTime > 0) {
+            mechanicsDisplayTime--;
+            if (mechanicsDisplayTime == 0) {
+                showMechanics = false;
+            }
+        }
+    }
+
+    void steerShip(int& x, int& cooldown, bool left, bool right, bool fire) {
+        if (right && !left) {
+            if (x < worldWidth - 2) x += 2;
+        } else if (left && !right) {
+            if (x > 1) x -= 2;
+        }
+
+        if (fire && cooldown <= 0) {
+            bullets.spawn(BULLET_PLAYER, x, playerY - 1);
+            cooldown = PLAYER_FIRE_COOLDOWN;
+        }
+
+        if (cooldown > 0) cooldown--;
+    }
+
+    // One tick of input for both ships. The partner only moves, fires and
+    // quits; menus and restarts belong to the first ship.
+    void applyInputs(unsigned keys, unsigned partnerKeys) {
+        applyInput(keys);
+        if (partnerKeys & INPUT_QUIT) gameOver = true;
+        if (!coop || showTitleScreen) return;
+
+        bool left = (partnerKeys & INPUT_LEFT) != 0;
+        bool right = (partnerKeys & INPUT_RIGHT) != 0;
+        if (left && right) {
+            if (partnerX < worldWidth / 2) {
+                left = false;
+            } else {
+                right = false;
+            }
+        }
+        steerShip(partnerX, partnerCooldown, left, right, (partnerKeys & INPUT_SPACE) != 0);
+    }
+
+    // Aimed patterns pick on one ship at a time, taking turns every two
+    // seconds in co-op.
+    int targetX() const {
+        return coop && (frameCount / 120) % 2 == 1 ? partnerX : playerX;
+    }
+
+    void toggleMechanics() {
+        showMechanics = !showMechanics;
+        if (showMechanics) {
+            mechanicsDisplayTime = 180;
+        }
+    }
+
+    void updateGame() {
+        if (gameOver || showTitleScreen) return;
+
+        frameCount++;
+
+        if (bossWarningTime > 0) bossWarningTime--;
+
+        bullets.update(parallel);
+        enemies.update(rng, bullets, targetX(), playerY, parallel);
+
+        {
+            ScopedPhase phase(profiler, PHASE_COLLISIONS);
+            checkCollisions();
+        }
+
+        if (frameCount % 900 == 0) {
+            spawnRegularBoss();
+        }
+
+        if (enemies.waveCleared()) {
+            if (!enemies.getRegistry().bossAlive()) {
+                if (wave % 3 == 0 && !giantBossSpawnedThisWave) {
+                    spawnGiantBoss();
+                } else {
+                    wave++;
+                    createEnemyWave();
+                }
+            }
+        }
+
+        if (giantBossSpawnedThisWave) {
+            if (enemies.aliveCount(ENEMY_GIANT) == 0) {
+                giantBossDefeatTimer++;
+
+                if (giantBossDefeatTimer > 180) {
+                    wave++;
+                    createEnemyWave();
+                    giantBossDefeatTimer = 0;
+                }
+            }
+        }
+
+        publishEnemyEvents();
+
+        if (lives <= 0) gameOver = true;
+    }
+
+    void hitEnemy(int kind, size_t index, BulletLane& shots, size_t shot) {
+        shots.active[shot] = 0;
+        enemies.damage(kind, index);
+    }
+
+    // Enemy bullets move at most a row a tick, so testing where they are
+    // now against the ship sprites misses nothing.
+    void checkPlayerHits() {
+        const SpriteAtlas& atlas = spriteAtlas();
+        for (int kind = BULLET_ENEMY; kind < BULLET_KIND_COUNT; kind++) {
+            BulletLane& shots = bullets.lane(kind);
+            for (size_t i = 0; i < shots.size(); i++) {
+                if (!shots.active[i]) continue;
+
+                int dy = shots.y[i] - playerY;
+                if (atlas.covers(SPRITE_PLAYER, shots.x[i] - playerX, dy) ||
+                    (coop && atlas.covers(SPRITE_PARTNER, shots.x[i] - partnerX, dy))) {
+                    shots.active[i] = 0;
+                    lives--;
+                    stats.hitsTaken[kind]++;
+                    if (lives <= 0) gameOver = true;
+                }
+            }
+        }
+    }
+
+    // Grid ids number the enemy lanes back to back, regular enemies first.
+    void decodeEnemyId(int id, int& kind, size_t& index) const {
+        kind = 0;
+        index = (size_t)id;
+        while (index >= enemies.lane(kind).size()) {
+            index -= enemies.lane(kind).size();
+            kind++;
+        }
+    }
+
+    // Every live enemy's sprite masks ORed into enemyCells, one kind after
+    // another. The sprite is a constant inside each instantiation.
+    template <int Kind>
+    void rasterizeEnemies(EnemyKindTag<Kind>) {
+        const EnemyLane& lane = enemies.lane(Kind);
+        const SpriteView sprite = spriteAtlas().view(enemySprite(Kind));
+        for (size_t i = 0; i < lane.size(); i++) {
+            if (!lane.alive[i]) continue;
+            int left = lane.x[i] - sprite.originX;
+            int top = lane.y[i] - sprite.originY;
+            for (int r = 0; r < sprite.height; r++) enemyCells.orMask(left, top + r, sprite.masks[r]);
+        }
+        rasterizeEnemies(EnemyKindTag<Kind + 1>());
+    }
+
+    void rasterizeEnemies(EnemyKindTag<ENEMY_KIND_COUNT>) {}
+
+    // Grid boxes for one kind, starting at grid id `id`, then the next kind.
+    // Each box is the sprite's bounding box.
+    template <int Kind>
+    void fillEnemyBoxes(EnemyKindTag<Kind>, size_t id) {
+        const EnemyLane& lane = enemies.lane(Kind);
+        const SpriteView sprite = spriteAtlas().view(enemySprite(Kind));
+        for (size_t i = 0; i < lane.size(); i++, id++) {
+            GridBox& box = enemyBoxes[id];
+            if (lane.alive[i]) {
+                box.minX = lane.x[i] - sprite.originX;
+                box.maxX = box.minX + sprite.width - 1;
+                box.minY = lane.y[i] - sprite.originY;
+                box.maxY = box.minY + sprite.height - 1;
+            } else {
+                box.minX = 1;
+                box.maxX = 0;
+            }
+        }
+        fillEnemyBoxes(EnemyKindTag<Kind + 1>(), id);
+    }
+
+    void fillEnemyBoxes(EnemyKindTag<ENEMY_KIND_COUNT>, size_t) {}
+
+    // The first live enemy, in grid id order, whose sprite covers (x, y).
+    // Hits it with the shot and returns true, or returns false.
+    bool hitEnemyAt(int x, int y, BulletLane& shots, size_t shot) {
+        const SpriteAtlas& atlas = spriteAtlas();
+        const int* begin;
+        const int* end;
+        collisionGrid.cell(x, y, begin, end);
+        for (const int* cell = begin; cell != end; ++cell) {
+            int kind;
+            size_t index;
+            decodeEnemyId(*cell, kind, index);
+            const EnemyLane& lane = enemies.lane(kind);
+            if (lane.alive[index] && atlas.covers(enemySprite(kind), x - lane.x[index], y - lane.y[index])) {
+                hitEnemy(kind, index, shots, shot);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Enemy sprites and the cells player shots swept through this tick are
+    // rasterized into two bitboards. Most ticks they don't overlap at all,
+    // which one AND/popcount pass over the rows shows without building
+    // the grid. Otherwise each shot checks the rows it crossed, nearest to
+    // where it came from first, and only a set enemy bit costs a grid
+    // lookup. Cells list enemies in id order, so the enemy that gets hit is
+    // the same one the plain nested scan picks.
+    void checkCollisions() {
+        enemyCells.clear();
+        rasterizeEnemies(EnemyKindTag<0>());
+
+        BulletLane& shots = bullets.lane(BULLET_PLAYER);
+        shotCells.clear();
+        for (size_t b = 0; b < shots.size(); b++) {
+            if (!shots.active[b]) continue;
+            for (int r = 0; r < PLAYER_BULLET_STEP; r++) shotCells.set(shots.x[b], shots.y[b] + r);
+        }
+
+        if (shotCells.overlap(enemyCells) > 0) {
+            enemyBoxes.resize(enemies.size());
+            fillEnemyBoxes(EnemyKindTag<0>(), 0);
+            collisionGrid.build(enemyBoxes);
+
+            for (size_t b = 0; b < shots.size(); b++) {
+                if (!shots.active[b]) continue;
+                int bx = shots.x[b];
+                for (int r = PLAYER_BULLET_STEP - 1; r >= 0; r--) {
+                    int by = shots.y[b] + r;
+                    if (enemyCells.test(bx, by) && hitEnemyAt(bx, by, shots, b)) break;
+                }
+            }
+        }
+
+        checkPlayerHits();
+        publishEnemyEvents();
+    }
+
+    // The plain O(bullets x enemies) scan with the same sprite tests, kept
+    // as the reference the bitboards and the grid are checked against in
+    // --stress runs.
+    void checkCollisionsBruteForce() {
+        const SpriteAtlas& atlas = spriteAtlas();
+        BulletLane& shots = bullets.lane(BULLET_PLAYER);
+        for (size_t b = 0; b < shots.size(); b++) {
+            if (!shots.active[b]) continue;
+            bool hit = false;
+
+            for (int r = PLAYER_BULLET_STEP - 1; r >= 0 && !hit; r--) {
+                int bx = shots.x[b];
+                int by = shots.y[b] + r;
+                for (int kind = 0; kind < ENEMY_KIND_COUNT && !hit; kind++) {
+                    const EnemyLane& lane = enemies.lane(kind);
+                    for (size_t i = 0; i < lane.size(); i++) {
+                        if (!lane.alive[i]) continue;
+
+                        if (atlas.covers(enemySprite(kind), bx - lane.x[i], by - lane.y[i])) {
+                            hitEnemy(kind, i, shots, b);
+                            hit = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        checkPlayerHits();
+        publishEnemyEvents();
+    }
+
+    // Replaces the wave with enemyCount enemies scattered over the top half
+    // of the field and bulletCount bullets (mostly the player's) over the
+    // whole field, for collision stress tests.
+    void spawnStressField(int enemyCount, int bulletCount) {
+        showTitleScreen = false;
+        enemies.clear();
+        bullets.clear();
+
+        enemies.reserve(enemyCount);
+        enemyBoxes.reserve(enemyCount);
+        collisionGrid.reserve(enemyBoxes.capacity(), 4);
+        for (int i = 0; i < enemyCount; i++) {
+            int roll = rng.nextInt(100);
+            int kind = roll < 1 ? ENEMY_GIANT : (roll < 10 ? ENEMY_BOSS : ENEMY_REGULAR);
+            enemies.spawn(kind, 1 + rng.nextInt(worldWidth - 2), 1 + rng.nextInt(worldHeight / 2 - 2));
+        }
+
+        bullets.reserve(BULLET_PLAYER, bulletCount);
+        bullets.reserve(BULLET_ENEMY, bulletCount);
+        for (int i = 0; i < bulletCount; i++) {
+            int x = rng.nextInt(worldWidth);
+            int y = rng.nextInt(worldHeight);
+            bullets.spawn(rng.nextInt(10) != 0 ? BULLET_PLAYER : BULLET_ENEMY, x, y);
+        }
+    }
+
+    // Skips the title screen and jumps straight to the giant boss of the
+    // given wave, with the regular enemies already cleared.
+    void startGiantBossFight(int bossWave) {
+        showTitleScreen = false;
+        wave = bossWave;
+        enemies.clear();
+        bullets.clear();
+        spawnGiantBoss();
+    }
+
+    // Just the entity update passes (bullets, then enemies), without
+    // collisions or wave logic, for measuring per-entity update cost.
+    void updateEntities() {
+        bullets.update(parallel);
+        enemies.update(rng, bullets, targetX(), playerY, parallel);
+    }
+
+    // The title screen and the mechanics box are drawn in viewport
+    // coordinates, whatever the world size.
+    void centerText(int y, const char* text) {
+        int length = (int)strlen(text);
+        renderer.text((renderer.getWidth() - length) / 2, y, text, length);
+    }
+
+    void renderTitleScreen() {
+        renderer.setOrigin(0, 0);
+        renderer.clear();
+
+        centerText(5, "RESPONSIVE GALAGA");
+        centerText(10, titleSelection == 0 ? "> START GAME <" : "  START GAME  ");
+        centerText(12, titleSelection == 0 ? "  EXIT GAME  " : "> EXIT GAME <");
+        centerText(16, "CONTROLS: ARROWS/ENTER/M");
+
+        renderer.addLine("");
+        renderer.addLine("  FEATURES:");
+        renderer.addLine("  - Classic space shooter");
+        renderer.addLine("  - Regular & GIANT BOSS battles!");
+        renderer.addLine("  - Responsive controls");
+        renderer.addLine("  - Multiple enemy waves");
+        renderer.addLine("  - Mechanics display (M key)");
+        renderer.addLine("");
+        renderer.addLine("  MECHANICS:");
+        renderer.addLine("  - Enemies: 10 pts, Bosses: 100 pts");
+        renderer.addLine("  - GIANT BOSS: 300 pts, 15 HP!");
+        renderer.addLine("  - Giant boss appears every 3 waves");
+        renderer.addLine("  - Start with 10 lives");
+    }
+
+    void renderMechanics() {
+        int boxWidth = 50;
+        int boxHeight = 16;
+        int boxX = (renderer.getWidth() - boxWidth) / 2;
+        int boxY = (renderer.getHeight() - boxHeight) / 2;
+        renderer.setOrigin(0, 0);
+
+        for (int x = boxX; x < boxX + boxWidth; x++) {
+            renderer.setChar(x, boxY, '=');
+            renderer.setChar(x, boxY + boxHeight - 1, '=');
+        }
+        for (int y = boxY; y < boxY + boxHeight; y++) {
+            renderer.setChar(boxX, y, '|');
+            renderer.setChar(boxX + boxWidth - 1, y, '|');
+        }
+
+        const char* title = "GAME MECHANICS";
+        int titleLength = (int)strlen(title);
+        renderer.text(boxX + (boxWidth - titleLength) / 2, boxY + 1, title, titleLength);
+
+        static const char* const mechanics[] = {
+            "CONTROLS:",
+            "  A/D or ARROWS: Move",
+            "  SPACE: Shoot",
+            "  M: Show/Hide Mechanics",
+            "  R: Restart",
+            "  Q: Quit",
+            "",
+            "SCORING:",
+            "  Regular Enemy: 10 pts",
+            "  Boss Enemy: 100 pts",
+            "  GIANT BOSS: 300 pts",
+            "  Boss HP: 3, Giant: 15",
+            "",
+            "GIANT BOSS SPAWN:",
+            "  - Appears every 3 waves",
+            "  - Only after clearing all",
+            "    regular enemies",
+            "",
+            "Press M to close"
+        };
+
+        const int lineCount = sizeof(mechanics) / sizeof(mechanics[0]);
+        for (int i = 0; i < lineCount; i++) {
+            int length = min((int)strlen(mechanics[i]), boxWidth - 4);
+            renderer.text(boxX + 2, boxY + 3 + i, mechanics[i], length);
+        }
+    }
+
+    void render(ostream& out) {
+        composeFrame();
+        renderer.draw(out);
+    }
+
+    // Every live enemy of one kind, then the next kind.
+    template <int Kind>
+    void drawEnemies(EnemyKindTag<Kind>) {
+        const EnemyArchetype& archetype = ENEMY_ARCHETYPES[Kind];
+        const EnemyLane& lane = enemies.lane(Kind);
+        const SpriteView sprite = spriteAtlas().view(archetype.sprite);
+        int pipsLeft = -sprite.originX;
+
+        for (size_t i = 0; i < lane.size(); i++) {
+            if (!lane.alive[i]) continue;
+
+            renderer.blit(sprite, lane.x[i], lane.y[i]);
+            if (archetype.healthBar == HEALTH_PIPS) {
+                renderer.fill(lane.x[i] + pipsLeft, lane.y[i] - 1, '=', lane.health[i]);
+            } else if (archetype.healthBar == HEALTH_GAUGE) {
+                drawBossGauge(lane.x[i], lane.y[i], lane.health[i], archetype.health);
+            }
+        }
+        drawEnemies(EnemyKindTag<Kind + 1>());
+    }
+
+    void drawEnemies(EnemyKindTag<ENEMY_KIND_COUNT>) {}
+
+    // Draws just the playfield into the renderer's viewport: the player,
+    // bullets and enemies, no status lines. Never allocates.
+    void composeField() {
+        renderer.setOrigin(getViewX(), getViewY());
+        renderer.clear();
+
+        renderer.blit(spriteAtlas(), SPRITE_PLAYER, playerX, playerY);
+        if (coop) renderer.blit(spriteAtlas(), SPRITE_PARTNER, partnerX, playerY);
+
+        const char bulletGlyphs[BULLET_KIND_COUNT] = { '|', '!', '*', 'o' };
+        for (int kind = 0; kind < BULLET_KIND_COUNT; kind++) {
+            const BulletLane& shots = bullets.lane(kind);
+            for (size_t i = 0; i < shots.size(); i++) {
+                if (shots.active[i]) {
+                    renderer.setChar(shots.x[i], shots.y[i], bulletGlyphs[kind]);
+                }
+            }
+        }
+
+        drawEnemies(EnemyKindTag<0>());
+    }
+
+    // Builds the next frame (viewport and status lines) in the renderer
+    // without writing anything out.
+    void composeFrame() {
+        if (showTitleScreen) {
+            renderTitleScreen();
+            return;
+        }
+
+        composeField();
+
+        if (showMechanics) {
+            renderMechanics();
+        }
+
+        // Built in a stack buffer so the steady-state tick doesn't allocate.
+        char status[160];
+        int length = snprintf(status, sizeof(status), " Score: %d | Lives: %d | Wave: %d", score, lives, wave);
+
+        int giantHealth = enemies.giantHealth();
+        if (giantHealth >= 0) {
+            length += snprintf(status + length, sizeof(status) - length, " | GIANT BOSS: %d HP", giantHealth);
+        }
+
+        if (bossWarningTime > 0) {
+            length += snprintf(status + length, sizeof(status) - length, " | WARNING: GIANT BOSS INCOMING!");
+        } else if (wave % 3 == 0 && !giantBossSpawnedThisWave) {
+            length += snprintf(status + length, sizeof(status) - length, " | NEXT: GIANT BOSS WAVE!");
+        }
+
+        length += snprintf(status + length, sizeof(status) - length, " | Enemies: %d", (int)enemies.aliveCount());
+        renderer.addLine(status, min((size_t)length, sizeof(status) - 1));
+
+        if (profiler && profiler->isOverlayVisible()) {
+            const vector<string>& overlay = profiler->overlayLines();
+            for (size_t i = 0; i < overlay.size(); i++) renderer.addLine(overlay[i]);
+        }
+
+        renderer.addLine(" [A/D] Move | [SPACE] Shoot | [R] Restart | [Q] Quit | [M] Mechanics | [P] Profiler");
+
+        if (gameOver) {
+            renderer.addLine(" GAME OVER! Press R to restart or Q to quit");
+        }
+
+        if (!showMechanics) {
+            static const char* const hints[] = {
+                " TIP: GIANT BOSS appears every 3 waves after clearing enemies!",
+                " TIP: Giant boss has 15 HP and fires spread patterns!",
+                " TIP: Regular bosses (100 pts) appear every 15 seconds",
+                " TIP: Regular bosses are slower and only have 3 HP!",
+                " TIP: Clear all regular enemies to advance to next wave!",
+                " TIP: Defeat the giant boss to earn 300 points!"
+            };
+
+            int hintIndex = (frameCount / 300) % (sizeof(hints) / sizeof(hints[0]));
+            renderer.addLine(hints[hintIndex]);
+        } else {
+            renderer.addLine("");
+        }
+    }
+
+    const ConsoleRenderer& getRenderer() const { return renderer; }
+    ConsoleRenderer& getRenderer() { return renderer; }
+
+    // Starts a fresh game as if constructed with `seed`, reusing every
+    // buffer, and skips the title screen.
+    void restart(uint64_t seed) {
+        rng.reseed(seed);
+        resetGame();
+        showTitleScreen = false;
+    }
+
+    void resetGame() {
+        placeShips();
+        score = 0;
+        lives = 10;
+        wave = 1;
+        gameOver = false;
+        showTitleScreen = true;
+        showMechanics = false;
+        titleSelection = 0;
+        leftPressed = rightPressed = spacePressed = false;
+        upPressed = downPressed = enterPressed = false;
+        bullets.clear();
+        enemies.clear();
+        createEnemyWave();
+        frameCount = 0;
+        shootCooldown = 0;
+        mechanicsDisplayTime = 0;
+        giantBossSpawnedThisWave = false;
+        giantBossDefeatTimer = 0;
+        bossWarningTime = 0;
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    void saveSnapshot(Snapshot& snapshot) const {
+        GameState& s = snapshot.state;
+        s.rng = rng;
+        s.playerX = playerX;
+        s.score = score;
+        s.lives = lives;
+        s.wave = wave;
+        s.titleSelection = titleSelection;
+        s.frameCount = frameCount;
+        s.shootCooldown = shootCooldown;
+        s.mechanicsDisplayTime = mechanicsDisplayTime;
+        s.giantBossDefeatTimer = giantBossDefeatTimer;
+        s.bossWarningTime = bossWarningTime;
+        s.partnerX = partnerX;
+        s.partnerCooldown = partnerCooldown;
+        s.coop = coop;
+        s.gameOver = gameOver;
+        s.showTitleScreen = showTitleScreen;
+        s.showMechanics = showMechanics;
+        s.giantBossSpawnedThisWave = giantBossSpawnedThisWave;
+        s.leftPressed = leftPressed;
+        s.rightPressed = rightPressed;
+        s.spacePressed = spacePressed;
+        s.upPressed = upPressed;
+        s.downPressed = downPressed;
+        s.enterPressed = enterPressed;
+        s.stats = stats;
+
+        SnapshotWriter writer(snapshot);
+        for (int kind = 0; kind < BULLET_KIND_COUNT; kind++) {
+            snapshot.bulletCounts[kind] = (uint32_t)bullets.lane(kind).size();
+            writer.put(bullets.lane(kind));
+        }
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) {
+            snapshot.enemyCounts[kind] = (uint32_t)enemies.lane(kind).size();
+            writer.put(enemies.lane(kind));
+        }
+        writer.put(enemies.slotTable());
+    }
+
+    // Puts the game back exactly where saveSnapshot() found it. The input
+    // source and the renderer are not game state and are left alone.
+    void loadSnapshot(const Snapshot& snapshot) {
+        const GameState& s = snapshot.state;
+        rng = s.rng;
+        playerX = s.playerX;
+        score = s.score;
+        lives = s.lives;
+        wave = s.wave;
+        titleSelection = s.titleSelection;
+        frameCount = s.frameCount;
+        shootCooldown = s.shootCooldown;
+        mechanicsDisplayTime = s.mechanicsDisplayTime;
+        giantBossDefeatTimer = s.giantBossDefeatTimer;
+        bossWarningTime = s.bossWarningTime;
+        partnerX = s.partnerX;
+        partnerCooldown = s.partnerCooldown;
+        coop = s.coop != 0;
+        gameOver = s.gameOver;
+        showTitleScreen = s.showTitleScreen;
+        showMechanics = s.showMechanics;
+        giantBossSpawnedThisWave = s.giantBossSpawnedThisWave;
+        leftPressed = s.leftPressed;
+        rightPressed = s.rightPressed;
+        spacePressed = s.spacePressed;
+        upPressed = s.upPressed;
+        downPressed = s.downPressed;
+        enterPressed = s.enterPressed;
+        stats = s.stats;
+
+        SnapshotReader reader(snapshot);
+        for (int kind = 0; kind < BULLET_KIND_COUNT; kind++) {
+            reader.take(bullets.lane(kind), snapshot.bulletCounts[kind]);
+        }
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) {
+            reader.take(enemies.lane(kind), snapshot.enemyCounts[kind]);
+        }
+        reader.take(enemies.slotTable());
+        enemies.recount();
+    }
+
+    // Fingerprint of everything that influences future ticks, so replays
+    // can tell the moment two runs stop agreeing.
+    uint64_t stateHash() const {
+        StateHash h;
+        h.add((int64_t)rng.getState());
+        h.add(playerX);
+        h.add(score);
+        h.add(lives);
+        h.add(wave);
+        h.add(gameOver);
+        h.add(showTitleScreen);
+        h.add(showMechanics);
+        h.add(titleSelection);
+        h.add(frameCount);
+        h.add(shootCooldown);
+        h.add(mechanicsDisplayTime);
+        h.add(giantBossSpawnedThisWave);
+        h.add(giantBossDefeatTimer);
+        h.add(bossWarningTime);
+        if (coop) {
+            h.add(partnerX);
+            h.add(partnerCooldown);
+        }
+
+        for (int kind = 0; kind < BULLET_KIND_COUNT; kind++) {
+            const BulletLane& lane = bullets.lane(kind);
+            h.add(lane.x, lane.size());
+            h.add(lane.y, lane.size());
+            h.add(lane.movePhase, lane.size());
+            h.add(lane.active, lane.size());
+            if (lane.hasVelocity) {
+                h.add(lane.vx, lane.size());
+                h.add(lane.vy, lane.size());
+                h.add(lane.fracX, lane.size());
+                h.add(lane.fracY, lane.size());
+            }
+        }
+
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; kind++) {
+            const EnemyLane& lane = enemies.lane(kind);
+            h.add(lane.x, lane.size());
+            h.add(lane.y, lane.size());
+            h.add(lane.health, lane.size());
+            h.add(lane.direction, lane.size());
+            h.add(lane.movePhase, lane.size());
+            h.add(lane.shootCooldown, lane.size());
+            h.add(lane.patternCounter, lane.size());
+            h.add(lane.alive, lane.size());
+        }
+
+        return h.value();
+    }
+
+    bool isGameOver() const { return gameOver; }
+    bool isShowingTitleScreen() const { return showTitleScreen; }
+    int getScore() const { return score; }
+    int getLives() const { return lives; }
+    int getWave() const { return wave; }
+    int getFrameCount() const { return frameCount; }
+    const GameStats& getStats() const { return stats; }
+    size_t getBulletCount() const { return bullets.size(); }
+    int getAliveEnemyCount() const { return enemies.aliveCount(); }
+    int getAliveBossCount() const {
+        return enemies.aliveCount(ENEMY_BOSS) + enemies.aliveCount(ENEMY_GIANT);
+    }
+    int getGiantBossHealth() const { return enemies.giantHealth(); }
+    int getPlayerX() const { return playerX; }
+    int getPartnerX() const { return partnerX; }
+    bool isCoop() const { return coop; }
+};
+
+#endif
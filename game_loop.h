@@ -0,0 +1,130 @@
+#ifndef GAME_LOOP_H
+#define GAME_LOOP_H
+
+#include <chrono>
+#include <thread>
+#include <cmath>
+
+using namespace std;
+
+struct LoopStats {
+    long long ticks;
+    long long frames;
+    long long missedTicks;
+    double meanFrameMs;
+    double jitterMs;
+    double maxFrameMs;
+
+    LoopStats() : ticks(0), frames(0), missedTicks(0), meanFrameMs(0), jitterMs(0), maxFrameMs(0) {}
+};
+
+// Classic accumulator loop: the simulation advances in fixed steps of
+// 1/tickRate no matter how long rendering takes, and frames are drawn at
+// most renderRate times a second (and only when a tick actually changed
+// something). Between deadlines the thread sleeps instead of spinning; only
+// the last spinMargin before a deadline is spent yielding, to absorb the
+// OS timer's coarseness.
+class FixedStepLoop {
+private:
+    typedef chrono::steady_clock Clock;
+
+    Clock::duration tickInterval;
+    Clock::duration renderInterval;
+    Clock::duration spinMargin;
+    int maxCatchUpTicks;
+    LoopStats stats;
+
+    double frameSumMs;
+    double frameSumSqMs;
+
+    static Clock::duration toDuration(double seconds) {
+        return chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+    }
+
+    void sleepUntil(Clock::time_point wake) {
+        if (wake - Clock::now() > spinMargin) {
+            this_thread::sleep_until(wake - spinMargin);
+        }
+        while (Clock::now() < wake) {
+            this_thread::yield();
+        }
+    }
+
+    void recordFrame(double frameMs) {
+        stats.frames++;
+        frameSumMs += frameMs;
+        frameSumSqMs += frameMs * frameMs;
+        if (frameMs > stats.maxFrameMs) stats.maxFrameMs = frameMs;
+
+        stats.meanFrameMs = frameSumMs / stats.frames;
+        double variance = frameSumSqMs / stats.frames - stats.meanFrameMs * stats.meanFrameMs;
+        stats.jitterMs = variance > 0 ? sqrt(variance) : 0;
+    }
+
+public:
+    FixedStepLoop(double tickRate = 60.0, double renderRate = 60.0, int maxCatchUpTicks = 5) :
+        tickInterval(toDuration(1.0 / tickRate)),
+        renderInterval(toDuration(1.0 / renderRate)),
+        spinMargin(chrono::microseconds(500)),
+        maxCatchUpTicks(maxCatchUpTicks),
+        frameSumMs(0), frameSumSqMs(0) {}
+
+    // tick() advances the simulation one step, render() draws the current
+    // state and running() decides when to stop. Ticks that cannot be caught
+    // up within maxCatchUpTicks are dropped and counted as missed rather
+    // than letting the game fall further and further behind.
+    template <typename Tick, typename Render, typename Running>
+    void run(Tick tick, Render render, Running running) {
+        Clock::time_point previous = Clock::now();
+        Clock::time_point nextRender = previous;
+        Clock::time_point lastFrame = previous;
+        Clock::duration accumulator = Clock::duration::zero();
+        bool dirty = true;
+        bool firstFrame = true;
+
+        while (running()) {
+            Clock::time_point now = Clock::now();
+            accumulator += now - previous;
+            previous = now;
+
+            int steps = 0;
+            while (accumulator >= tickInterval) {
+                if (steps == maxCatchUpTicks) {
+                    long long behind = accumulator / tickInterval;
+                    stats.missedTicks += behind;
+                    accumulator -= tickInterval * behind;
+                    break;
+                }
+                tick();
+                accumulator -= tickInterval;
+                stats.ticks++;
+                steps++;
+                dirty = true;
+            }
+
+            if (!running()) break;
+
+            now = Clock::now();
+            if (dirty && now >= nextRender) {
+                render();
+                dirty = false;
+
+                if (!firstFrame) {
+                    recordFrame(chrono::duration<double, milli>(now - lastFrame).count());
+                }
+                firstFrame = false;
+                lastFrame = now;
+
+                nextRender += renderInterval;
+                if (nextRender < now) nextRender = now + renderInterval;
+            }
+
+            Clock::time_point nextTick = previous + (tickInterval - accumulator);
+            sleepUntil(dirty && nextRender < nextTick ? nextRender : nextTick);
+        }
+    }
+
+    const LoopStats& getStats() const { return stats; }
+};
+
+#endif
@@ -0,0 +1,657 @@
+#ifndef GAME_SERVER_H
+#define GAME_SERVER_H
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include "game.h"
+#include "console.h"
+#include "input_thread.h"
+#include "thread_pool.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+const SocketHandle NO_SOCKET = INVALID_SOCKET;
+#else
+typedef int SocketHandle;
+const SocketHandle NO_SOCKET = -1;
+#endif
+
+inline void closeSocket(SocketHandle s) {
+    if (s == NO_SOCKET) return;
+#ifdef _WIN32
+    closesocket(s);
+#else
+    ::close(s);
+#endif
+}
+
+inline void setNonBlocking(SocketHandle s) {
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(s, FIONBIO, &nonBlocking);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+inline bool socketWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+// A connected, non-blocking stream socket, TCP or Unix.
+class StreamSocket {
+private:
+    SocketHandle fd;
+
+public:
+    explicit StreamSocket(SocketHandle fd = NO_SOCKET) : fd(fd) {}
+    ~StreamSocket() { close(); }
+
+    StreamSocket(const StreamSocket&) = delete;
+    StreamSocket& operator=(const StreamSocket&) = delete;
+
+    bool valid() const { return fd != NO_SOCKET; }
+    SocketHandle handle() const { return fd; }
+
+    void close() {
+        closeSocket(fd);
+        fd = NO_SOCKET;
+    }
+
+    // Bytes read, 0 when nothing is waiting, -1 once the peer has gone.
+    int receive(char* buffer, size_t capacity) {
+        int n = (int)recv(fd, buffer, (int)capacity, 0);
+        if (n > 0) return n;
+        if (n < 0 && socketWouldBlock()) return 0;
+        return -1;
+    }
+
+    // Bytes written, fewer than asked (maybe 0) when the socket buffer is
+    // full, -1 on error.
+    int send(const char* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+        int n = (int)::send(fd, data, (int)size, MSG_NOSIGNAL);
+#else
+        int n = (int)::send(fd, data, (int)size, 0);
+#endif
+        if (n >= 0) return n;
+        return socketWouldBlock() ? 0 : -1;
+    }
+};
+
+// Accepts players on a TCP port or, outside Windows, a Unix socket path.
+class SocketListener {
+private:
+    SocketHandle fd;
+    string unixPath;
+
+public:
+    SocketListener() : fd(NO_SOCKET) {
+#ifdef _WIN32
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+    }
+
+    ~SocketListener() {
+        close();
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    SocketListener(const SocketListener&) = delete;
+    SocketListener& operator=(const SocketListener&) = delete;
+
+    // Port 0 picks any free port. Only loopback clients get in unless
+    // `anyAddress` is set.
+    bool listenTcp(uint16_t port, bool anyAddress) {
+        close();
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == NO_SOCKET) return false;
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(anyAddress ? INADDR_ANY : INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (::bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+            close();
+            return false;
+        }
+        setNonBlocking(fd);
+        return true;
+    }
+
+#ifndef _WIN32
+    bool listenUnix(const string& path) {
+        close();
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size());
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == NO_SOCKET) return false;
+        unlink(path.c_str());
+        if (::bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+            close();
+            return false;
+        }
+        unixPath = path;
+        setNonBlocking(fd);
+        return true;
+    }
+#endif
+
+    void close() {
+        closeSocket(fd);
+        fd = NO_SOCKET;
+#ifndef _WIN32
+        if (!unixPath.empty()) unlink(unixPath.c_str());
+#endif
+        unixPath.clear();
+    }
+
+    uint16_t localPort() const {
+        sockaddr_in address;
+        socklen_t length = sizeof(address);
+        if (getsockname(fd, (sockaddr*)&address, &length) != 0 || address.sin_family != AF_INET) return 0;
+        return ntohs(address.sin_port);
+    }
+
+    // The next waiting client, already non-blocking, or NO_SOCKET.
+    SocketHandle accept() {
+        SocketHandle client = ::accept(fd, nullptr, nullptr);
+        if (client == NO_SOCKET) return NO_SOCKET;
+        setNonBlocking(client);
+        if (unixPath.empty()) {
+            int noDelay = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+        }
+        return client;
+    }
+};
+
+// A blocking connect to 127.0.0.1, then non-blocking, for local clients
+// such as the capacity benchmark's.
+inline SocketHandle connectLoopback(uint16_t port) {
+    SocketHandle s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == NO_SOCKET) return NO_SOCKET;
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (connect(s, (sockaddr*)&address, sizeof(address)) != 0) {
+        closeSocket(s);
+        return NO_SOCKET;
+    }
+    setNonBlocking(s);
+    return s;
+}
+
+// Appends everything written to it to a string, so a renderer can draw
+// straight into a session's send buffer.
+class StringBuffer : public streambuf {
+private:
+    string& target;
+
+protected:
+    int_type overflow(int_type c) {
+        if (c != traits_type::eof()) target.push_back((char)c);
+        return c;
+    }
+
+    streamsize xsputn(const char* s, streamsize n) {
+        target.append(s, (size_t)n);
+        return n;
+    }
+
+public:
+    explicit StringBuffer(string& target) : target(target) {}
+};
+
+struct SessionStats {
+    long long ticks;
+    long long frames;
+    long long lateTicks;        // started a whole tick or more after their deadline
+    long long missedTicks;      // skipped after falling more than maxCatchUpTicks behind
+    long long droppedFrames;    // not sent because the client wasn't reading
+    unsigned long long bytesIn;
+    unsigned long long bytesOut;
+    LatencyHistogram lateness;  // deadline to the moment a worker picked the session up
+
+    SessionStats() : ticks(0), frames(0), lateTicks(0), missedTicks(0), droppedFrames(0),
+                     bytesIn(0), bytesOut(0) {}
+
+    void merge(const SessionStats& other) {
+        ticks += other.ticks;
+        frames += other.frames;
+        lateTicks += other.lateTicks;
+        missedTicks += other.missedTicks;
+        droppedFrames += other.droppedFrames;
+        bytesIn += other.bytesIn;
+        bytesOut += other.bytesOut;
+        lateness.merge(other.lateness);
+    }
+};
+
+// One player: a socket, a game, and the diff renderer's idea of what that
+// player's terminal shows. A session is only ever run by one pool task at
+// a time, so nothing in it is locked.
+class GameSession {
+private:
+    typedef chrono::steady_clock Clock;
+
+    // Frames stop being composed while this much output is still unsent,
+    // and the next one that goes out repaints the whole screen.
+    static const size_t MAX_BACKLOG = 64 * 1024;
+
+    enum { TELNET_SE = 240, TELNET_SB = 250, TELNET_WILL = 251, TELNET_DONT = 254, TELNET_IAC = 255,
+           TELNET_ECHO = 1, TELNET_SGA = 3 };
+
+    // Where the input parser is inside a telnet command.
+    enum TelnetState { TELNET_DATA, TELNET_COMMAND, TELNET_OPTION, TELNET_SUBNEGOTIATION, TELNET_SUBNEGOTIATION_IAC };
+
+    int id;
+    StreamSocket socket;
+    ResponsiveGame game;
+    string outbox;
+    size_t outboxSent;
+    StringBuffer outboxBuffer;
+    ostream out;
+    Clock::time_point deadline;
+    Clock::duration interval;
+    int maxCatchUpTicks;
+    TelnetState telnet;
+    bool open;
+    SessionStats stats;
+
+    // Telnet clients mix IAC commands into their input. They are dropped
+    // here, even across reads; a raw client never sends byte 255.
+    unsigned decodeInput(char* bytes, int count) {
+        int kept = 0;
+        for (int i = 0; i < count; i++) {
+            unsigned char c = (unsigned char)bytes[i];
+            switch (telnet) {
+                case TELNET_DATA:
+                    if (c == TELNET_IAC) {
+                        telnet = TELNET_COMMAND;
+                    } else {
+                        bytes[kept++] = bytes[i];
+                    }
+                    break;
+                case TELNET_COMMAND:
+                    if (c >= TELNET_WILL && c <= TELNET_DONT) {
+                        telnet = TELNET_OPTION;
+                    } else if (c == TELNET_SB) {
+                        telnet = TELNET_SUBNEGOTIATION;
+                    } else {
+                        telnet = TELNET_DATA;
+                    }
+                    break;
+                case TELNET_OPTION:
+                    telnet = TELNET_DATA;
+                    break;
+                case TELNET_SUBNEGOTIATION:
+                    if (c == TELNET_IAC) telnet = TELNET_SUBNEGOTIATION_IAC;
+                    break;
+                case TELNET_SUBNEGOTIATION_IAC:
+                    telnet = c == TELNET_SE ? TELNET_DATA : TELNET_SUBNEGOTIATION;
+                    break;
+            }
+        }
+        return decodeKeys(bytes, (size_t)kept);
+    }
+
+    unsigned readKeys() {
+        char bytes[256];
+        unsigned keys = 0;
+        for (;;) {
+            int n = socket.receive(bytes, sizeof(bytes));
+            if (n < 0) {
+                open = false;
+                break;
+            }
+            if (n == 0) break;
+            stats.bytesIn += n;
+            keys |= decodeInput(bytes, n);
+        }
+        return keys;
+    }
+
+    void flush() {
+        while (outboxSent < outbox.size()) {
+            int n = socket.send(outbox.data() + outboxSent, outbox.size() - outboxSent);
+            if (n < 0) open = false;
+            if (n <= 0) break;
+            outboxSent += n;
+            stats.bytesOut += n;
+        }
+        if (outboxSent == outbox.size()) {
+            outbox.clear();
+            outboxSent = 0;
+        } else if (outboxSent > outbox.size() / 2) {
+            outbox.erase(0, outboxSent);
+            outboxSent = 0;
+        }
+    }
+
+public:
+    GameSession(int id, SocketHandle fd, uint64_t seed, Clock::time_point start,
+                Clock::duration interval, int maxCatchUpTicks, bool negotiateTelnet) :
+        id(id), socket(fd), game(nullptr, seed), outboxSent(0), outboxBuffer(outbox), out(&outboxBuffer),
+        deadline(start), interval(interval), maxCatchUpTicks(maxCatchUpTicks), telnet(TELNET_DATA), open(true) {
+        outbox.reserve(MAX_BACKLOG);
+        if (negotiateTelnet) {
+            // Server echoes and no go-ahead: puts telnet in character mode.
+            const char negotiate[] = { (char)TELNET_IAC, (char)TELNET_WILL, (char)TELNET_ECHO,
+                                       (char)TELNET_IAC, (char)TELNET_WILL, (char)TELNET_SGA };
+            outbox.append(negotiate, sizeof(negotiate));
+        }
+        outbox += "\x1b[2J\x1b[H\x1b[?25l";
+        flush();
+    }
+
+    GameSession(const GameSession&) = delete;
+    GameSession& operator=(const GameSession&) = delete;
+
+    int getId() const { return id; }
+    bool isOpen() const { return open; }
+    Clock::time_point nextDeadline() const { return deadline; }
+    const SessionStats& getStats() const { return stats; }
+    void resetStats() { stats = SessionStats(); }
+    const ResponsiveGame& getGame() const { return game; }
+
+    // One scheduled slice: every tick that has come due (at most
+    // maxCatchUpTicks; the rest are skipped and counted), then one frame.
+    // Keys read now apply to the first of those ticks.
+    void run() {
+        Clock::time_point now = Clock::now();
+        Clock::duration late = now - deadline;
+        stats.lateness.add(chrono::duration_cast<chrono::nanoseconds>(late).count());
+        if (late >= interval) stats.lateTicks++;
+
+        long long due = late / interval + 1;
+        deadline += interval * due;
+        if (due > maxCatchUpTicks) {
+            stats.missedTicks += due - maxCatchUpTicks;
+            due = maxCatchUpTicks;
+        }
+
+        unsigned keys = readKeys();
+        if (keys & INPUT_QUIT) open = false;
+        if (!open) return;
+
+        for (long long t = 0; t < due; t++) {
+            game.applyInput(t == 0 ? keys : 0);
+            game.updateGame();
+            stats.ticks++;
+        }
+
+        if (outbox.size() - outboxSent > MAX_BACKLOG) {
+            stats.droppedFrames++;
+            game.getRenderer().invalidate();
+        } else {
+            game.composeFrame();
+            game.getRenderer().draw(out);
+            stats.frames++;
+        }
+        flush();
+    }
+
+    // Puts the player's terminal back the way it was, as far as a
+    // non-blocking send allows, and hangs up.
+    void close() {
+        if (socket.valid()) {
+            outbox += "\x1b[?25h\r\n";
+            flush();
+            socket.close();
+        }
+        open = false;
+    }
+};
+
+struct ServerConfig {
+    double tickRate;
+    int threads;            // 0 uses every core, 1 runs sessions on the scheduler thread
+    int maxSessions;
+    int maxCatchUpTicks;
+    uint64_t seed;
+    bool telnet;
+
+    ServerConfig() : tickRate(60.0), threads(0), maxSessions(1024), maxCatchUpTicks(5), seed(1),
+                     telnet(false) {}
+};
+
+// Hosts many games at once. The scheduler thread keeps every session's
+// next deadline in a heap; whenever some come due it deals them, in
+// deadline order, to the shared pool in chunks and waits for the batch,
+// then sleeps until the next deadline. Each session keeps its own phase
+// (one tick after it connected), so a thousand players spread over the
+// tick interval instead of all landing on the same instant.
+//
+// Stats are only read and reset by the scheduler thread between batches,
+// when no session is running.
+class GameServer {
+private:
+    typedef chrono::steady_clock Clock;
+    typedef pair<Clock::time_point, int> Due;
+
+    static const int CHUNKS_PER_WORKER = 4;
+
+    ServerConfig config;
+    SocketListener& listener;
+    WorkStealingPool* pool;
+    size_t workers;
+    Clock::duration interval;
+
+    vector<GameSession*> sessions;  // by slot; nullptr when free
+    vector<int> freeSlots;
+    priority_queue<Due, vector<Due>, greater<Due> > deadlines;
+    vector<int> batch;
+    size_t batchChunks;
+    int nextId;
+    size_t liveCount;
+    long long accepted;
+    long long rejected;
+    SessionStats retired;           // sessions that have hung up since the last reset
+
+    atomic<bool> stopping;
+    atomic<bool> resetRequested;
+    function<void(const GameSession&)> onClose;
+
+    void runChunk(size_t c) {
+        size_t begin = batch.size() * c / batchChunks;
+        size_t end = batch.size() * (c + 1) / batchChunks;
+        for (size_t i = begin; i < end; i++) sessions[batch[i]]->run();
+    }
+
+    // The task captures only `this` and the chunk number, small enough for
+    // std::function to keep inline.
+    void runBatch() {
+        if (!pool) {
+            batchChunks = 1;
+            runChunk(0);
+            return;
+        }
+        batchChunks = min(batch.size(), workers * CHUNKS_PER_WORKER);
+        for (size_t c = 0; c < batchChunks; c++) {
+            pool->submit([this, c]() { runChunk(c); });
+        }
+        pool->wait();
+    }
+
+    void acceptClients(Clock::time_point now) {
+        for (;;) {
+            SocketHandle client = listener.accept();
+            if (client == NO_SOCKET) return;
+            if ((int)liveCount >= config.maxSessions) {
+                StreamSocket full(client);
+                const char message[] = "Server full, try again later.\r\n";
+                full.send(message, sizeof(message) - 1);
+                rejected++;
+                continue;
+            }
+
+            int slot;
+            if (!freeSlots.empty()) {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            } else {
+                slot = (int)sessions.size();
+                sessions.push_back(nullptr);
+            }
+            int id = nextId++;
+            sessions[slot] = new GameSession(id, client, config.seed + (uint64_t)id, now + interval,
+                                             interval, config.maxCatchUpTicks, config.telnet);
+            deadlines.push(Due(sessions[slot]->nextDeadline(), slot));
+            liveCount++;
+            accepted++;
+        }
+    }
+
+    void retire(int slot) {
+        GameSession* session = sessions[slot];
+        session->close();
+        if (onClose) onClose(*session);
+        retired.merge(session->getStats());
+        delete session;
+        sessions[slot] = nullptr;
+        freeSlots.push_back(slot);
+        liveCount--;
+    }
+
+    void resetStats() {
+        retired = SessionStats();
+        for (size_t s = 0; s < sessions.size(); s++) {
+            if (sessions[s]) sessions[s]->resetStats();
+        }
+        accepted = 0;
+        rejected = 0;
+    }
+
+public:
+    GameServer(const ServerConfig& config, SocketListener& listener) :
+        config(config), listener(listener), pool(nullptr), workers(1), batchChunks(1), nextId(1),
+        liveCount(0), accepted(0), rejected(0), stopping(false), resetRequested(false) {
+        this->config.tickRate = max(this->config.tickRate, 1.0);
+        this->config.maxCatchUpTicks = max(this->config.maxCatchUpTicks, 1);
+        interval = chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / this->config.tickRate));
+        if (config.threads != 1) {
+            pool = new WorkStealingPool(config.threads > 0 ? (size_t)config.threads : 0);
+            workers = pool->size();
+        }
+    }
+
+    ~GameServer() {
+        for (size_t s = 0; s < sessions.size(); s++) {
+            if (sessions[s]) retire((int)s);
+        }
+        delete pool;
+    }
+
+    GameServer(const GameServer&) = delete;
+    GameServer& operator=(const GameServer&) = delete;
+
+    size_t threadCount() const { return pool ? workers : 1; }
+
+    // Called on the scheduler thread for every session that hangs up.
+    void setOnClose(function<void(const GameSession&)> callback) { onClose = callback; }
+
+    // Safe from any thread (or a signal handler); run() returns soon after.
+    void stop() { stopping = true; }
+
+    // Zeroes every counter at the next point the scheduler is between
+    // batches, e.g. once a benchmark's clients have all connected.
+    void requestStatsReset() { resetRequested = true; }
+
+    // Runs until stop(). `report`, if set, is called on the scheduler
+    // thread every `reportSeconds`, when it is safe to read stats.
+    void run(function<void()> report = function<void()>(), double reportSeconds = 0) {
+        Clock::duration acceptPoll = chrono::milliseconds(5);
+        Clock::duration reportInterval =
+            chrono::duration_cast<Clock::duration>(chrono::duration<double>(reportSeconds));
+        Clock::time_point nextReport = Clock::now() + reportInterval;
+
+        while (!stopping) {
+            Clock::time_point now = Clock::now();
+            if (resetRequested.exchange(false)) resetStats();
+            acceptClients(now);
+
+            batch.clear();
+            while (!deadlines.empty() && deadlines.top().first <= now) {
+                batch.push_back(deadlines.top().second);
+                deadlines.pop();
+            }
+            if (!batch.empty()) runBatch();
+
+            for (size_t i = 0; i < batch.size(); i++) {
+                int slot = batch[i];
+                if (sessions[slot]->isOpen()) {
+                    deadlines.push(Due(sessions[slot]->nextDeadline(), slot));
+                } else {
+                    retire(slot);
+                }
+            }
+
+            now = Clock::now();
+            if (report && reportSeconds > 0 && now >= nextReport) {
+                report();
+                nextReport = now + reportInterval;
+            }
+
+            Clock::time_point wake = now + acceptPoll;
+            if (!deadlines.empty() && deadlines.top().first < wake) wake = deadlines.top().first;
+            this_thread::sleep_until(wake);
+        }
+    }
+
+    size_t sessionCount() const { return liveCount; }
+    long long acceptedCount() const { return accepted; }
+    long long rejectedCount() const { return rejected; }
+
+    // Everything since the last reset: sessions that hung up plus the ones
+    // still playing.
+    SessionStats totals() const {
+        SessionStats total = retired;
+        for (size_t s = 0; s < sessions.size(); s++) {
+            if (sessions[s]) total.merge(sessions[s]->getStats());
+        }
+        return total;
+    }
+};
+
+#endif
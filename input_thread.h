@@ -0,0 +1,153 @@
+#ifndef INPUT_THREAD_H
+#define INPUT_THREAD_H
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include "console.h"
+#include "spsc_queue.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+using namespace std;
+
+struct KeyEvent {
+    unsigned keys;
+    int64_t timestampNs;    // steady_clock, when the input thread read it
+};
+
+// Latencies in fixed 250us buckets up to 50ms, plus one overflow bucket.
+class LatencyHistogram {
+private:
+    static const int BUCKET_US = 250;
+    static const int BUCKETS = 200;
+
+    long long counts[BUCKETS + 1];
+    long long total;
+    int64_t maxNs;
+    double sumNs;
+
+public:
+    LatencyHistogram() : total(0), maxNs(0), sumNs(0) {
+        fill(counts, counts + BUCKETS + 1, 0LL);
+    }
+
+    void add(int64_t ns) {
+        int bucket = (int)min<int64_t>(ns / (BUCKET_US * 1000), BUCKETS);
+        counts[max(bucket, 0)]++;
+        total++;
+        maxNs = max(maxNs, ns);
+        sumNs += ns;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int b = 0; b <= BUCKETS; b++) counts[b] += other.counts[b];
+        total += other.total;
+        maxNs = max(maxNs, other.maxNs);
+        sumNs += other.sumNs;
+    }
+
+    long long count() const { return total; }
+    double meanMs() const { return total ? sumNs / total / 1e6 : 0; }
+    double maxMs() const { return maxNs / 1e6; }
+
+    // Upper edge of the bucket holding the p-th percentile, in ms.
+    double percentileMs(int p) const {
+        if (total == 0) return 0;
+        long long rank = (total * p + 99) / 100;
+        long long seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += counts[b];
+            if (seen >= rank) return (b + 1) * BUCKET_US / 1000.0;
+        }
+        return maxMs();
+    }
+};
+
+// Reads the keyboard on its own thread, so keys are picked up the moment
+// they arrive instead of whenever the game thread gets around to it. Each
+// read becomes a timestamped KeyEvent in a lock-free queue; poll() drains
+// the queue once per tick. takeConsumed() hands the timestamps of the
+// events consumed so far to whoever shows the resulting frame, which is
+// where input-to-frame latency gets measured.
+class ThreadedKeyboardInput : public InputSource {
+private:
+    typedef chrono::steady_clock Clock;
+
+    static const int MAX_PENDING = 64;
+
+    KeyboardInput keyboard;
+    SpscQueue<KeyEvent, 256> events;
+    atomic<bool> running;
+    atomic<long long> dropped;
+    thread reader;
+
+    int64_t pending[MAX_PENDING];
+    int pendingCount;
+
+    // Sleeps until there is input or a few ms have passed, so the thread
+    // notices shutdown promptly without spinning.
+    static void waitForInput() {
+#ifdef _WIN32
+        if (!_kbhit()) Sleep(1);
+#else
+        struct pollfd fd;
+        fd.fd = STDIN_FILENO;
+        fd.events = POLLIN;
+        ::poll(&fd, 1, 5);
+#endif
+    }
+
+    void readLoop() {
+        while (running.load(memory_order_relaxed)) {
+            waitForInput();
+            unsigned keys = keyboard.poll();
+            if (keys == 0) continue;
+
+            KeyEvent event = { keys, nowNs() };
+            if (!events.push(event)) dropped.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+public:
+    static int64_t nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    ThreadedKeyboardInput() : running(true), dropped(0), pendingCount(0) {
+        reader = thread(&ThreadedKeyboardInput::readLoop, this);
+    }
+
+    ~ThreadedKeyboardInput() { stop(); }
+
+    void stop() {
+        running.store(false);
+        if (reader.joinable()) reader.join();
+    }
+
+    unsigned poll() {
+        unsigned keys = 0;
+        KeyEvent event;
+        while (events.pop(event)) {
+            keys |= event.keys;
+            if (pendingCount < MAX_PENDING) pending[pendingCount++] = event.timestampNs;
+        }
+        return keys;
+    }
+
+    // Moves up to `room` consumed-event timestamps into `out`; returns how
+    // many. Game thread only, like poll().
+    int takeConsumed(int64_t* out, int room) {
+        int count = min(room, pendingCount);
+        copy(pending, pending + count, out);
+        pendingCount = 0;
+        return count;
+    }
+    long long getDropped() const { return dropped.load(); }
+};
+
+#endif
@@ -0,0 +1,589 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include "game.h"
+#include "rng.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+inline int64_t netClockUs() {
+    return chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Non-blocking IPv4 UDP socket talking to a single peer. The host learns
+// its peer from the first datagram it receives.
+class UdpSocket {
+private:
+#ifdef _WIN32
+    SOCKET fd;
+    static bool validHandle(SOCKET s) { return s != INVALID_SOCKET; }
+#else
+    int fd;
+    static bool validHandle(int s) { return s >= 0; }
+#endif
+    sockaddr_in peer;
+    bool hasPeer;
+
+public:
+    UdpSocket() : hasPeer(false) {
+#ifdef _WIN32
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+        fd = INVALID_SOCKET;
+#else
+        fd = -1;
+#endif
+        memset(&peer, 0, sizeof(peer));
+    }
+
+    ~UdpSocket() {
+        close();
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // Port 0 picks any free port.
+    bool open(uint16_t port) {
+        close();
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (!validHandle(fd)) return false;
+
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        if (::bind(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+            close();
+            return false;
+        }
+#ifdef _WIN32
+        u_long nonBlocking = 1;
+        ioctlsocket(fd, FIONBIO, &nonBlocking);
+#else
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+        return true;
+    }
+
+    void close() {
+        if (!validHandle(fd)) return;
+#ifdef _WIN32
+        closesocket(fd);
+        fd = INVALID_SOCKET;
+#else
+        ::close(fd);
+        fd = -1;
+#endif
+    }
+
+    uint16_t localPort() const {
+        sockaddr_in address;
+        socklen_t length = sizeof(address);
+        if (getsockname(fd, (sockaddr*)&address, &length) != 0) return 0;
+        return ntohs(address.sin_port);
+    }
+
+    bool setPeer(const string& host, uint16_t port) {
+        memset(&peer, 0, sizeof(peer));
+        peer.sin_family = AF_INET;
+        peer.sin_port = htons(port);
+        hasPeer = inet_pton(AF_INET, host.c_str(), &peer.sin_addr) == 1;
+        return hasPeer;
+    }
+
+    bool connected() const { return hasPeer; }
+
+    void send(const uint8_t* data, size_t size) {
+        if (!hasPeer) return;
+        sendto(fd, (const char*)data, (int)size, 0, (const sockaddr*)&peer, sizeof(peer));
+    }
+
+    // One datagram, or -1 when none is waiting. Until a peer is set, the
+    // sender of the first datagram becomes the peer.
+    int receive(uint8_t* buffer, size_t capacity) {
+        sockaddr_in from;
+        socklen_t length = sizeof(from);
+        int size = (int)recvfrom(fd, (char*)buffer, (int)capacity, 0, (sockaddr*)&from, &length);
+        if (size < 0) return -1;
+        if (!hasPeer) {
+            peer = from;
+            hasPeer = true;
+        } else if (from.sin_addr.s_addr != peer.sin_addr.s_addr || from.sin_port != peer.sin_port) {
+            return -1;
+        }
+        return size;
+    }
+};
+
+// Outgoing half of a bad network: drops a share of the datagrams and holds
+// the rest back for a latency plus random jitter before handing them to
+// the socket. Jitter can reorder datagrams, as a real network does.
+// Each peer simulates its own outgoing link, so a round trip sees both.
+class NetworkSimulator {
+private:
+    struct Delayed {
+        int64_t dueUs;
+        vector<uint8_t> bytes;
+    };
+
+    UdpSocket& socket;
+    Rng rng;
+    int lossPerMille;
+    int latencyUs;
+    int jitterUs;
+    deque<Delayed> queue;
+    long long dropped;
+
+public:
+    NetworkSimulator(UdpSocket& socket, uint64_t seed, double lossPercent = 0, int latencyMs = 0,
+                     int jitterMs = 0) :
+        socket(socket), rng(seed), lossPerMille((int)(lossPercent * 10)),
+        latencyUs(latencyMs * 1000), jitterUs(jitterMs * 1000), dropped(0) {}
+
+    void send(const uint8_t* data, size_t size) {
+        if (lossPerMille > 0 && rng.nextInt(1000) < lossPerMille) {
+            dropped++;
+            return;
+        }
+        if (latencyUs == 0 && jitterUs == 0) {
+            socket.send(data, size);
+            return;
+        }
+
+        Delayed packet;
+        packet.dueUs = netClockUs() + latencyUs + (jitterUs > 0 ? rng.nextInt(jitterUs + 1) : 0);
+        packet.bytes.assign(data, data + size);
+        deque<Delayed>::iterator at = queue.end();
+        while (at != queue.begin() && (at - 1)->dueUs > packet.dueUs) --at;
+        queue.insert(at, packet);
+    }
+
+    // Sends everything whose delay has run out.
+    void flush() {
+        int64_t now = netClockUs();
+        while (!queue.empty() && queue.front().dueUs <= now) {
+            socket.send(queue.front().bytes.data(), queue.front().bytes.size());
+            queue.pop_front();
+        }
+    }
+
+    long long droppedCount() const { return dropped; }
+};
+
+// The ship bits that travel over the wire, one byte per tick.
+enum ShipBits {
+    SHIP_LEFT  = 1 << 0,
+    SHIP_RIGHT = 1 << 1,
+    SHIP_FIRE  = 1 << 2,
+    SHIP_QUIT  = 1 << 3
+};
+
+inline uint8_t packShipKeys(unsigned keys) {
+    return (uint8_t)(((keys & INPUT_LEFT) ? SHIP_LEFT : 0) | ((keys & INPUT_RIGHT) ? SHIP_RIGHT : 0) |
+                     ((keys & INPUT_SPACE) ? SHIP_FIRE : 0) | ((keys & INPUT_QUIT) ? SHIP_QUIT : 0));
+}
+
+inline unsigned unpackShipKeys(uint8_t bits) {
+    return ((bits & SHIP_LEFT) ? INPUT_LEFT : 0) | ((bits & SHIP_RIGHT) ? INPUT_RIGHT : 0) |
+           ((bits & SHIP_FIRE) ? INPUT_SPACE : 0) | ((bits & SHIP_QUIT) ? INPUT_QUIT : 0);
+}
+
+struct LockstepConfig {
+    uint64_t seed;
+    int worldWidth, worldHeight;
+    int inputDelay;             // ticks between sampling a key and applying it
+    int hashInterval;           // ticks between state hash exchanges
+    double lossPercent;         // simulated, on this peer's outgoing link
+    int latencyMs;
+    int jitterMs;
+
+    LockstepConfig() : seed(1), worldWidth(WIDTH), worldHeight(HEIGHT), inputDelay(3),
+                       hashInterval(60), lossPercent(0), latencyMs(0), jitterMs(0) {}
+};
+
+struct LockstepStats {
+    long long ticks;
+    long long packetsSent, packetsReceived;
+    long long bytesSent, bytesReceived;     // UDP payload only
+    long long packetsDropped;               // by the simulator
+    long long stalls;                       // times a tick was due without the peer's input
+    long long stallTicks;                   // tick slots spent waiting
+    long long hashesCompared;
+    long long desyncs;
+    long long firstDesyncTick;              // -1 while the peers agree
+
+    LockstepStats() : ticks(0), packetsSent(0), packetsReceived(0), bytesSent(0), bytesReceived(0),
+                      packetsDropped(0), stalls(0), stallTicks(0), hashesCompared(0), desyncs(0),
+                      firstDesyncTick(-1) {}
+};
+
+// Deterministic lockstep for two ships. Both peers run the same game from
+// the same seed and only exchange the ship bits for every tick: a key read
+// at tick t is applied at t + inputDelay on both sides, and a tick only
+// runs once both peers' bits for it are in. The host flies the first ship.
+//
+// Every input packet repeats all the local bits the peer has not yet
+// acknowledged, run-length encoded the way replays are, so a lost packet
+// is covered by the next one without any resend timer. Every hashInterval
+// ticks both sides hash their state and swap the hashes; a mismatch means
+// the simulations have diverged.
+//
+// Wire format (little endian, varints as in replay.h):
+//   HELLO    'G' 1
+//   WELCOME  'G' 2 seed:u64 inputDelay:u8 hashInterval:u16 width:u16 height:u16
+//   INPUT    'G' 3 ack:varint first:varint (runLength:varint bits:u8)* 0
+//            [hashTick:varint hash:u64]
+class LockstepSession {
+private:
+    enum PacketType {
+        MAGIC = 'G',
+        PACKET_HELLO = 1,
+        PACKET_WELCOME = 2,
+        PACKET_INPUT = 3
+    };
+    static const int MAX_PACKET = 1200;
+    static const int MAX_REDUNDANT_TICKS = 256;
+    static const int HASH_SLOTS = 64;
+    static const int HASH_REPEATS = 8;          // packets that carry each new hash
+    static const int64_t RESEND_US = 20000;     // while stalled
+    static const int64_t TIMEOUT_US = 5000000;
+
+    struct HashSlot {
+        long long tick;
+        uint64_t hash;
+    };
+
+    UdpSocket& socket;
+    NetworkSimulator link;
+    bool host;
+    bool welcomed;
+    bool refused;
+    LockstepConfig config;
+
+    vector<uint8_t> localBits;      // by tick; the first inputDelay are zero
+    vector<uint8_t> remoteBits;
+    size_t peerAck;                 // local ticks the peer holds
+    long long tick;                 // next tick to simulate
+    bool waiting;
+
+    HashSlot localHashes[HASH_SLOTS];
+    HashSlot remoteHashes[HASH_SLOTS];
+    long long lastHashTick;
+    int hashSendsLeft;
+
+    int64_t lastSendUs;
+    int64_t lastHeardUs;
+    LockstepStats stats;
+    uint8_t buffer[MAX_PACKET];
+    vector<uint8_t> packet;
+
+    static void putVarint(vector<uint8_t>& out, unsigned long long value) {
+        while (value >= 0x80) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    static void putFixed(vector<uint8_t>& out, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) out.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    // Bounds-checked reads over one received datagram.
+    struct Reader {
+        const uint8_t* at;
+        const uint8_t* end;
+        bool ok;
+
+        Reader(const uint8_t* data, int size) : at(data), end(data + size), ok(true) {}
+
+        uint8_t byte() {
+            if (at >= end) {
+                ok = false;
+                return 0;
+            }
+            return *at++;
+        }
+
+        unsigned long long varint() {
+            unsigned long long value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                uint8_t b = byte();
+                value |= (unsigned long long)(b & 0x7F) << shift;
+                if (!(b & 0x80)) return value;
+            }
+            ok = false;
+            return 0;
+        }
+
+        uint64_t fixed(int bytes) {
+            uint64_t value = 0;
+            for (int i = 0; i < bytes; i++) value |= (uint64_t)byte() << (8 * i);
+            return value;
+        }
+
+        bool done() const { return at == end; }
+    };
+
+    void transmit() {
+        link.send(packet.data(), packet.size());
+        stats.packetsSent++;
+        stats.bytesSent += packet.size();
+        lastSendUs = netClockUs();
+    }
+
+    void sendHello() {
+        packet.clear();
+        packet.push_back(MAGIC);
+        packet.push_back(PACKET_HELLO);
+        transmit();
+    }
+
+    void sendWelcome() {
+        packet.clear();
+        packet.push_back(MAGIC);
+        packet.push_back(PACKET_WELCOME);
+        putFixed(packet, config.seed, 8);
+        putFixed(packet, (uint64_t)config.inputDelay, 1);
+        putFixed(packet, (uint64_t)config.hashInterval, 2);
+        putFixed(packet, (uint64_t)config.worldWidth, 2);
+        putFixed(packet, (uint64_t)config.worldHeight, 2);
+        transmit();
+    }
+
+    void sendInputs() {
+        packet.clear();
+        packet.push_back(MAGIC);
+        packet.push_back(PACKET_INPUT);
+        putVarint(packet, remoteBits.size());
+        putVarint(packet, peerAck);
+
+        size_t end = min(localBits.size(), peerAck + MAX_REDUNDANT_TICKS);
+        size_t t = peerAck;
+        while (t < end) {
+            size_t run = 1;
+            while (t + run < end && localBits[t + run] == localBits[t]) run++;
+            putVarint(packet, run);
+            packet.push_back(localBits[t]);
+            t += run;
+        }
+        packet.push_back(0);
+
+        if (hashSendsLeft > 0) {
+            const HashSlot& slot = localHashes[(lastHashTick / config.hashInterval) % HASH_SLOTS];
+            putVarint(packet, (unsigned long long)slot.tick);
+            putFixed(packet, slot.hash, 8);
+            hashSendsLeft--;
+        }
+        transmit();
+    }
+
+    void compareHashes(long long hashTick) {
+        const HashSlot& mine = localHashes[(hashTick / config.hashInterval) % HASH_SLOTS];
+        const HashSlot& theirs = remoteHashes[(hashTick / config.hashInterval) % HASH_SLOTS];
+        if (mine.tick != hashTick || theirs.tick != hashTick) return;
+
+        stats.hashesCompared++;
+        if (mine.hash != theirs.hash) {
+            stats.desyncs++;
+            if (stats.firstDesyncTick < 0) stats.firstDesyncTick = hashTick;
+        }
+    }
+
+    void receiveInputs(Reader& reader) {
+        size_t ack = (size_t)reader.varint();
+        size_t t = (size_t)reader.varint();
+        if (!reader.ok) return;
+        if (ack > peerAck && ack <= localBits.size()) peerAck = ack;
+
+        for (;;) {
+            unsigned long long run = reader.varint();
+            if (!reader.ok || run == 0) break;
+            uint8_t bits = reader.byte();
+            // Runs start at the sender's view of our ack, which never passes
+            // what we hold, so anything new continues remoteBits exactly.
+            for (unsigned long long i = 0; i < run && reader.ok; i++, t++) {
+                if (t == remoteBits.size()) remoteBits.push_back(bits);
+            }
+        }
+
+        if (reader.ok && !reader.done()) {
+            long long hashTick = (long long)reader.varint();
+            uint64_t hash = reader.fixed(8);
+            if (reader.ok && hashTick > 0 && hashTick % config.hashInterval == 0) {
+                HashSlot& slot = remoteHashes[(hashTick / config.hashInterval) % HASH_SLOTS];
+                if (slot.tick != hashTick) {
+                    slot.tick = hashTick;
+                    slot.hash = hash;
+                    compareHashes(hashTick);
+                }
+            }
+        }
+    }
+
+    void receiveWelcome(Reader& reader) {
+        LockstepConfig offered = config;
+        offered.seed = reader.fixed(8);
+        offered.inputDelay = (int)reader.fixed(1);
+        offered.hashInterval = (int)reader.fixed(2);
+        offered.worldWidth = (int)reader.fixed(2);
+        offered.worldHeight = (int)reader.fixed(2);
+        if (!reader.ok || offered.hashInterval <= 0 || welcomed) return;
+        if (!worldSizeAllowed(offered.worldWidth, offered.worldHeight)) {
+            refused = true;
+            return;
+        }
+
+        config = offered;
+        welcomed = true;
+        start();
+    }
+
+    void start() {
+        localBits.assign(config.inputDelay, 0);
+        remoteBits.assign(config.inputDelay, 0);
+        peerAck = 0;
+        tick = 0;
+    }
+
+public:
+    // The host serves `config`; a joining peer adopts whatever the host
+    // sends back. Only the simulation settings (loss, latency, jitter) are
+    // the joiner's own.
+    LockstepSession(UdpSocket& socket, bool host, const LockstepConfig& config, uint64_t linkSeed) :
+        socket(socket), link(socket, linkSeed, config.lossPercent, config.latencyMs, config.jitterMs),
+        host(host), welcomed(false), refused(false), config(config), peerAck(0), tick(0), waiting(false),
+        lastHashTick(0), hashSendsLeft(0), lastSendUs(0), lastHeardUs(netClockUs()) {
+        for (int i = 0; i < HASH_SLOTS; i++) {
+            localHashes[i].tick = remoteHashes[i].tick = -1;
+            localHashes[i].hash = remoteHashes[i].hash = 0;
+        }
+        start();
+    }
+
+    // Reads every waiting datagram and sends whatever the simulated link
+    // has let through. Call often; the session never blocks.
+    void pump() {
+        link.flush();
+
+        int size;
+        while ((size = socket.receive(buffer, sizeof(buffer))) >= 0) {
+            Reader reader(buffer, size);
+            if (reader.byte() != MAGIC) continue;
+            uint8_t type = reader.byte();
+            if (!reader.ok) continue;
+
+            stats.packetsReceived++;
+            stats.bytesReceived += size;
+            lastHeardUs = netClockUs();
+
+            if (type == PACKET_HELLO && host) {
+                welcomed = true;
+                sendWelcome();
+            } else if (type == PACKET_WELCOME && !host) {
+                receiveWelcome(reader);
+            } else if (type == PACKET_INPUT && welcomed) {
+                receiveInputs(reader);
+            }
+        }
+        stats.packetsDropped = link.droppedCount();
+    }
+
+    // Until this is true the host is still waiting for a peer and the
+    // joiner for the host's settings. The joiner repeats its hello.
+    bool handshake() {
+        pump();
+        if (!host && !welcomed && netClockUs() - lastSendUs > 100000) {
+            sendHello();
+            link.flush();
+        }
+        return welcomed;
+    }
+
+    // The joiner got settings it won't play with (a world over
+    // MAX_WORLD_SIZE); the handshake will never finish.
+    bool welcomeRefused() const { return refused; }
+
+    // One tick slot: polls `input` for tick + inputDelay (once per tick, so
+    // keys pressed during a stall wait for the next tick instead of being
+    // lost), then runs the tick if the peer's bits are in. Returns whether
+    // the game advanced.
+    bool advance(ResponsiveGame& game, InputSource& input) {
+        pump();
+        if (!welcomed) return false;
+
+        if ((long long)localBits.size() == tick + config.inputDelay) {
+            localBits.push_back(packShipKeys(input.poll()));
+            sendInputs();
+        }
+
+        if ((long long)remoteBits.size() <= tick) {
+            if (!waiting) stats.stalls++;
+            waiting = true;
+            stats.stallTicks++;
+            if (netClockUs() - lastSendUs > RESEND_US) sendInputs();
+            link.flush();
+            return false;
+        }
+        waiting = false;
+
+        unsigned mine = unpackShipKeys(localBits[tick]);
+        unsigned theirs = unpackShipKeys(remoteBits[tick]);
+        game.applyInputs(host ? mine : theirs, host ? theirs : mine);
+        game.updateGame();
+        tick++;
+        stats.ticks++;
+
+        if (tick % config.hashInterval == 0) {
+            HashSlot& slot = localHashes[(tick / config.hashInterval) % HASH_SLOTS];
+            slot.tick = tick;
+            slot.hash = game.stateHash();
+            lastHashTick = tick;
+            hashSendsLeft = HASH_REPEATS;
+            compareHashes(tick);
+        }
+        link.flush();
+        return true;
+    }
+
+    // Sends any acknowledgement or hash the peer is still owed, so it can
+    // finish its last ticks after this side has stopped.
+    void linger() {
+        pump();
+        if (netClockUs() - lastSendUs > RESEND_US) sendInputs();
+        link.flush();
+    }
+
+    bool isHost() const { return host; }
+    bool peerTimedOut() const { return netClockUs() - lastHeardUs > TIMEOUT_US; }
+    long long currentTick() const { return tick; }
+    const LockstepConfig& getConfig() const { return config; }
+    const LockstepStats& getStats() const { return stats; }
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PARALLEL_UPDATE_H
+#define PARALLEL_UPDATE_H
+
+#include <cstddef>
+#include <algorithm>
+#include "thread_pool.h"
+
+using namespace std;
+
+// Runs one game's entity passes over fixed-size chunks on a pool of its
+// own. Chunk boundaries depend only on how many entities there are, never
+// on the thread count, and the stores do everything order-sensitive (Rng
+// draws, bullet spawns) between the parallel passes, in chunk order. So a
+// game updates bit-identically whether it has one of these or not, and
+// with any number of threads.
+//
+// Serves one game at a time: the stores keep their per-chunk scratch
+// themselves, but the pool's wait() covers every task it was given.
+class ParallelUpdate {
+private:
+    WorkStealingPool pool;
+    size_t chunkSize;
+    const void* body;
+    void (*invoke)(const void* body, size_t chunk, size_t begin, size_t end);
+    size_t count;
+
+    template <typename Body>
+    static void call(const void* body, size_t chunk, size_t begin, size_t end) {
+        (*static_cast<const Body*>(body))(chunk, begin, end);
+    }
+
+    void runChunk(size_t chunk) {
+        size_t begin = chunk * chunkSize;
+        invoke(body, chunk, begin, min(begin + chunkSize, count));
+    }
+
+public:
+    explicit ParallelUpdate(size_t threads, size_t chunkSize = 2048) :
+        pool(threads), chunkSize(chunkSize > 0 ? chunkSize : 1), body(nullptr), invoke(nullptr), count(0) {}
+
+    ParallelUpdate(const ParallelUpdate&) = delete;
+    ParallelUpdate& operator=(const ParallelUpdate&) = delete;
+
+    size_t threadCount() const { return pool.size(); }
+    size_t getChunkSize() const { return chunkSize; }
+
+    size_t chunkCount(size_t n) const { return (n + chunkSize - 1) / chunkSize; }
+
+    // Below two chunks the hand-off costs more than the loop it would split.
+    bool worthSplitting(size_t n) const { return n >= 2 * chunkSize; }
+
+    // Calls body(chunk, begin, end) once per chunk of [0, n), on the pool,
+    // and returns when every chunk is done.
+    template <typename Body>
+    void forEachChunk(size_t n, const Body& chunkBody) {
+        body = &chunkBody;
+        invoke = &call<Body>;
+        count = n;
+        size_t chunks = chunkCount(n);
+        for (size_t c = 0; c < chunks; c++) pool.submit([this, c]() { runChunk(c); });
+        pool.wait();
+    }
+};
+
+#endif
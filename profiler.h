@@ -0,0 +1,220 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+// Phases of one frame. UPDATE is the whole updateGame() call, so it
+// includes COLLISIONS.
+enum ProfilePhase {
+    PHASE_INPUT,
+    PHASE_UPDATE,
+    PHASE_COLLISIONS,
+    PHASE_COMPOSE,
+    PHASE_DRAW,
+    PHASE_COUNT
+};
+
+const char* const PHASE_NAMES[PHASE_COUNT] = { "input", "update", "collisions", "compose", "draw" };
+
+// Everything measured between two endFrame() calls. A frame that ran
+// several ticks adds their times together; start is the first occurrence.
+struct FrameSample {
+    int64_t startNs[PHASE_COUNT];
+    int64_t durationNs[PHASE_COUNT];
+};
+
+// Keeps the last `capacity` frames in a ring. Only the game thread writes;
+// a finished frame is published by bumping `published`, so a reader that
+// loads it with acquire ordering sees whole frames without any locking.
+// Recording is off until setEnabled(true); while off, ScopedPhase costs a
+// pointer and flag test.
+class FrameProfiler {
+private:
+    typedef chrono::steady_clock Clock;
+
+    vector<FrameSample> ring;
+    atomic<uint64_t> published;
+    FrameSample current;
+    Clock::time_point origin;
+    bool enabled;
+    bool overlayVisible;
+    int overlayAge;
+    vector<string> overlay;
+
+    static const size_t OVERLAY_WINDOW = 240;
+    static const int OVERLAY_REFRESH = 15;
+
+    void resetCurrent() {
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            current.startNs[p] = -1;
+            current.durationNs[p] = 0;
+        }
+    }
+
+    static double nsToMs(int64_t ns) { return ns / 1e6; }
+
+public:
+    explicit FrameProfiler(size_t capacity = 4096) :
+        ring(capacity ? capacity : 1), published(0), origin(Clock::now()),
+        enabled(false), overlayVisible(false), overlayAge(0) {
+        resetCurrent();
+    }
+
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool on) { enabled = on; }
+
+    bool isOverlayVisible() const { return overlayVisible; }
+
+    // Showing the overlay turns recording on; hiding it leaves recording
+    // alone so an export still gets everything.
+    void toggleOverlay() {
+        overlayVisible = !overlayVisible;
+        if (overlayVisible) {
+            enabled = true;
+            overlayAge = 0;
+        }
+    }
+
+    int64_t now() const {
+        return chrono::duration_cast<chrono::nanoseconds>(Clock::now() - origin).count();
+    }
+
+    void record(int phase, int64_t startNs, int64_t endNs) {
+        if (current.startNs[phase] < 0) current.startNs[phase] = startNs;
+        current.durationNs[phase] += endNs - startNs;
+    }
+
+    void endFrame() {
+        if (!enabled) return;
+        uint64_t frame = published.load(memory_order_relaxed);
+        ring[frame % ring.size()] = current;
+        published.store(frame + 1, memory_order_release);
+        resetCurrent();
+    }
+
+    uint64_t getFrameCount() const { return published.load(memory_order_acquire); }
+
+    size_t storedFrames() const {
+        return (size_t)min<uint64_t>(getFrameCount(), ring.size());
+    }
+
+    // Oldest stored frame first.
+    const FrameSample& storedFrame(size_t i) const {
+        uint64_t frames = getFrameCount();
+        return ring[(frames - storedFrames() + i) % ring.size()];
+    }
+
+    // Percentiles of one phase over the last `window` frames, in ms.
+    void summarize(int phase, size_t window, double& p50, double& p95, double& p99, double& maxMs) const {
+        size_t n = min(window, storedFrames());
+        size_t first = storedFrames() - n;
+        vector<int64_t> values(n);
+        for (size_t i = 0; i < n; i++) values[i] = storedFrame(first + i).durationNs[phase];
+        sort(values.begin(), values.end());
+
+        p50 = n ? nsToMs(values[n * 50 / 100]) : 0;
+        p95 = n ? nsToMs(values[n * 95 / 100]) : 0;
+        p99 = n ? nsToMs(values[n * 99 / 100]) : 0;
+        maxMs = n ? nsToMs(values[n - 1]) : 0;
+    }
+
+    // Footer lines for the overlay. Percentiles are recomputed every few
+    // frames rather than every frame so the overlay stays cheap and legible.
+    const vector<string>& overlayLines() {
+        if (overlayAge-- > 0 && !overlay.empty()) return overlay;
+        overlayAge = OVERLAY_REFRESH;
+
+        overlay.clear();
+        overlay.push_back(" PROFILE (ms, last 240 frames)   p50     p95     p99     max");
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            double p50, p95, p99, maxMs;
+            summarize(p, OVERLAY_WINDOW, p50, p95, p99, maxMs);
+            ostringstream line;
+            line << fixed << setprecision(3) << "   " << left << setw(29) << PHASE_NAMES[p] << right
+                 << setw(8) << p50 << setw(8) << p95 << setw(8) << p99 << setw(8) << maxMs;
+            overlay.push_back(line.str());
+        }
+        return overlay;
+    }
+
+    bool writeCsv(const string& path) const {
+        ofstream out(path.c_str());
+        if (!out) return false;
+
+        out << "frame";
+        for (int p = 0; p < PHASE_COUNT; p++) out << "," << PHASE_NAMES[p] << "_us";
+        out << "\n";
+
+        uint64_t firstFrame = getFrameCount() - storedFrames();
+        for (size_t i = 0; i < storedFrames(); i++) {
+            const FrameSample& sample = storedFrame(i);
+            out << firstFrame + i;
+            for (int p = 0; p < PHASE_COUNT; p++) out << "," << sample.durationNs[p] / 1000.0;
+            out << "\n";
+        }
+        return out.good();
+    }
+
+    // Chrome's trace viewer format (chrome://tracing, Perfetto): one
+    // complete event per phase per frame.
+    bool writeChromeTrace(const string& path) const {
+        ofstream out(path.c_str());
+        if (!out) return false;
+
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        for (size_t i = 0; i < storedFrames(); i++) {
+            const FrameSample& sample = storedFrame(i);
+            for (int p = 0; p < PHASE_COUNT; p++) {
+                if (sample.startNs[p] < 0) continue;
+                out << (first ? "\n" : ",\n") << "{\"name\":\"" << PHASE_NAMES[p]
+                    << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << sample.startNs[p] / 1000.0
+                    << ",\"dur\":" << sample.durationNs[p] / 1000.0 << "}";
+                first = false;
+            }
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return out.good();
+    }
+
+    // .json gets a Chrome trace, anything else CSV.
+    bool write(const string& path) const {
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        return json ? writeChromeTrace(path) : writeCsv(path);
+    }
+};
+
+// Times the enclosing scope into one phase. Building with
+// -DGALAGA_NO_PROFILER compiles every timer away entirely.
+class ScopedPhase {
+#ifndef GALAGA_NO_PROFILER
+private:
+    FrameProfiler* profiler;
+    int phase;
+    int64_t start;
+
+public:
+    ScopedPhase(FrameProfiler* p, int phase) :
+        profiler(p && p->isEnabled() ? p : nullptr), phase(phase),
+        start(profiler ? profiler->now() : 0) {}
+
+    ~ScopedPhase() {
+        if (profiler) profiler->record(phase, start, profiler->now());
+    }
+#else
+public:
+    ScopedPhase(FrameProfiler*, int) {}
+#endif
+};
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include "game.h"
+
+using namespace std;
+
+// Replay file layout (all integers little-endian):
+//
+//   "GRPL"  magic
+//   u8      version (3)
+//   u32     checksum interval in ticks
+//   u64     seed
+//   u32     world width, u32 world height
+//   records until 'E':
+//     'I' varint count, varint bits   input bits held for `count` ticks
+//     'C' varint tick, u64 hash       ResponsiveGame::stateHash() after `tick`
+//     'E' varint total ticks
+//
+// Inputs are run-length encoded, so idle stretches and held keys cost a
+// few bytes no matter how long they last.
+const char REPLAY_MAGIC[4] = { 'G', 'R', 'P', 'L' };
+// Version 2 stopped hashing compacted-away dead enemies; 3 added the world
+// size. Older files can't be checked against this build.
+const uint8_t REPLAY_VERSION = 3;
+const unsigned DEFAULT_CHECKSUM_INTERVAL = 60;
+
+// Records the wrapped source's input and a state checksum every `interval`
+// ticks. Call endTick() once after every updateGame().
+class ReplayRecorder : public InputSource {
+private:
+    InputSource* source;
+    ofstream out;
+    unsigned interval;
+    long long ticks;
+    unsigned runBits;
+    unsigned long long runLength;
+
+    void writeByte(uint8_t value) { out.put((char)value); }
+
+    void writeVarint(unsigned long long value) {
+        while (value >= 0x80) {
+            writeByte((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        writeByte((uint8_t)value);
+    }
+
+    void writeFixed(uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            writeByte((uint8_t)(value >> (8 * i)));
+        }
+    }
+
+    void flushRun() {
+        if (runLength == 0) return;
+        writeByte('I');
+        writeVarint(runLength);
+        writeVarint(runBits);
+        runLength = 0;
+    }
+
+public:
+    ReplayRecorder(InputSource* source, const string& path, uint64_t seed,
+                   int worldWidth = WIDTH, int worldHeight = HEIGHT,
+                   unsigned interval = DEFAULT_CHECKSUM_INTERVAL) :
+        source(source), out(path.c_str(), ios::binary), interval(interval ? interval : 1),
+        ticks(0), runBits(0), runLength(0) {
+        out.write(REPLAY_MAGIC, 4);
+        writeByte(REPLAY_VERSION);
+        writeFixed(this->interval, 4);
+        writeFixed(seed, 8);
+        writeFixed((uint32_t)worldWidth, 4);
+        writeFixed((uint32_t)worldHeight, 4);
+    }
+
+    ~ReplayRecorder() { close(); }
+
+    bool isOpen() const { return out.is_open() && out.good(); }
+
+    unsigned poll() {
+        unsigned keys = source ? source->poll() : 0;
+        if (runLength > 0 && keys != runBits) flushRun();
+        runBits = keys;
+        runLength++;
+        return keys;
+    }
+
+    void endTick(const ResponsiveGame& game) {
+        ticks++;
+        if (ticks % interval == 0) {
+            flushRun();
+            writeByte('C');
+            writeVarint(ticks);
+            writeFixed(game.stateHash(), 8);
+        }
+    }
+
+    void close() {
+        if (!out.is_open()) return;
+        flushRun();
+        writeByte('E');
+        writeVarint(ticks);
+        out.close();
+    }
+
+    long long getTicks() const { return ticks; }
+};
+
+// Feeds a recorded session back into a game and checks it against the
+// recorded checksums. The whole file is decoded up front so playback is
+// just walking two arrays.
+class ReplayPlayer : public InputSource {
+private:
+    struct InputRun {
+        unsigned bits;
+        unsigned long long length;
+    };
+
+    struct Checkpoint {
+        long long tick;
+        uint64_t hash;
+    };
+
+    uint64_t seed;
+    unsigned interval;
+    int worldWidth, worldHeight;
+    long long totalTicks;
+    vector<InputRun> runs;
+    vector<Checkpoint> checkpoints;
+
+    size_t runIndex;
+    unsigned long long runOffset;
+    size_t checkpointIndex;
+    long long ticks;
+    long long divergedTick;
+    uint64_t expectedHash;
+    uint64_t actualHash;
+
+    static bool readVarint(const vector<uint8_t>& data, size_t& pos, unsigned long long& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+            uint8_t byte = data[pos++];
+            value |= (unsigned long long)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    static bool readFixed(const vector<uint8_t>& data, size_t& pos, int bytes, uint64_t& value) {
+        if (pos + bytes > data.size()) return false;
+        value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value |= (uint64_t)data[pos++] << (8 * i);
+        }
+        return true;
+    }
+
+public:
+    ReplayPlayer() : seed(0), interval(DEFAULT_CHECKSUM_INTERVAL),
+                     worldWidth(WIDTH), worldHeight(HEIGHT), totalTicks(0),
+                     runIndex(0), runOffset(0), checkpointIndex(0), ticks(0),
+                     divergedTick(-1), expectedHash(0), actualHash(0) {}
+
+    bool load(const string& path, string& error) {
+        ifstream in(path.c_str(), ios::binary);
+        if (!in) {
+            error = "cannot open " + path;
+            return false;
+        }
+        vector<uint8_t> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+        size_t pos = 0;
+        uint64_t value;
+        if (data.size() < 25 || !equal(REPLAY_MAGIC, REPLAY_MAGIC + 4, data.begin())) {
+            error = "not a replay file";
+            return false;
+        }
+        pos = 4;
+        if (data[pos++] != REPLAY_VERSION) {
+            error = "unsupported replay version";
+            return false;
+        }
+        readFixed(data, pos, 4, value);
+        interval = (unsigned)value;
+        readFixed(data, pos, 8, seed);
+        uint64_t width, height;
+        readFixed(data, pos, 4, width);
+        readFixed(data, pos, 4, height);
+        if (!worldSizeAllowed((long long)width, (long long)height)) {
+            error = "replay world size out of range";
+            return false;
+        }
+        worldWidth = (int)width;
+        worldHeight = (int)height;
+
+        runs.clear();
+        checkpoints.clear();
+        totalTicks = -1;
+
+        while (pos < data.size() && totalTicks < 0) {
+            uint8_t tag = data[pos++];
+            unsigned long long a, b;
+            if (tag == 'I' && readVarint(data, pos, a) && readVarint(data, pos, b)) {
+                InputRun run = { (unsigned)b, a };
+                runs.push_back(run);
+            } else if (tag == 'C' && readVarint(data, pos, a) && readFixed(data, pos, 8, value)) {
+                Checkpoint checkpoint = { (long long)a, value };
+                checkpoints.push_back(checkpoint);
+            } else if (tag == 'E' && readVarint(data, pos, a)) {
+                totalTicks = (long long)a;
+            } else {
+                error = "corrupt replay record";
+                return false;
+            }
+        }
+
+        if (totalTicks < 0) {
+            // Recording was cut short (crash, kill); play what we have.
+            totalTicks = 0;
+            for (size_t i = 0; i < runs.size(); i++) totalTicks += runs[i].length;
+        }
+        return true;
+    }
+
+    uint64_t getSeed() const { return seed; }
+    int getWorldWidth() const { return worldWidth; }
+    int getWorldHeight() const { return worldHeight; }
+    long long getTotalTicks() const { return totalTicks; }
+    long long getTicks() const { return ticks; }
+    long long getDivergedTick() const { return divergedTick; }
+    uint64_t getExpectedHash() const { return expectedHash; }
+    uint64_t getActualHash() const { return actualHash; }
+    size_t getCheckpointCount() const { return checkpoints.size(); }
+
+    bool finished() const { return ticks >= totalTicks || divergedTick >= 0; }
+
+    unsigned poll() {
+        while (runIndex < runs.size() && runOffset >= runs[runIndex].length) {
+            runIndex++;
+            runOffset = 0;
+        }
+        if (runIndex >= runs.size()) return 0;
+        runOffset++;
+        return runs[runIndex].bits;
+    }
+
+    // Call after every updateGame(). Returns false once the simulation no
+    // longer matches the recording.
+    bool endTick(const ResponsiveGame& game) {
+        ticks++;
+        if (checkpointIndex < checkpoints.size() && checkpoints[checkpointIndex].tick == ticks) {
+            expectedHash = checkpoints[checkpointIndex].hash;
+            actualHash = game.stateHash();
+            checkpointIndex++;
+            if (expectedHash != actualHash) {
+                divergedTick = ticks;
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// Small xorshift64* generator. Every game owns one so that a seed plus the
+// input stream fully determines a session, independent of the C runtime.
+class Rng {
+private:
+    uint64_t state;
+
+public:
+    explicit Rng(uint64_t seed = 1) { reseed(seed); }
+
+    void reseed(uint64_t seed) {
+        // splitmix64 scramble so that small seeds still give a good state
+        uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        state = z ^ (z >> 31);
+        if (state == 0) state = 0x2545F4914F6CDD1DULL;
+    }
+
+    uint32_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint32_t)((state * 0x2545F4914F6CDD1DULL) >> 32);
+    }
+
+    uint64_t getState() const { return state; }
+
+    int nextInt(int bound) {
+        return boundedInt(next(), bound);
+    }
+
+    // What nextInt(bound) makes of a draw, for callers that take their
+    // draws ahead of time and spend them later.
+    static int boundedInt(uint32_t draw, int bound) {
+        return (int)(draw % (uint32_t)bound);
+    }
+};
+
+#endif
@@ -0,0 +1,651 @@
+#ifndef SESSION_RECORDING_H
+#define SESSION_RECORDING_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include "game.h"
+#include "spsc_queue.h"
+
+using namespace std;
+
+// Session recording layout (integers little-endian, varints as in replay.h):
+//
+//   "GCST"  magic
+//   u8      version (1)
+//   varint  keyframe interval in ms
+//   records until 'E':
+//     'K' varint time ms, varint width, varint height,
+//         (varint count, u8 char) runs covering all width x height cells,
+//         varint footer lines, then (varint length, bytes) per line
+//     'D' varint ms since the previous frame, varint span count, then per
+//         span in row-major order varint (unchanged cells before it << 2
+//         | min(length - 1, 3)), varint length - 4 if length >= 4, and the
+//         span's bytes,
+//         varint footer lines, varint mask of the lines that changed
+//         (lines past the 64th always count as changed), then
+//         (varint length, bytes) per changed line
+//     'E' varint ms since the previous frame
+//   'X' u32 seconds, then u64 file offset per second: the last keyframe
+//       at or before that second
+//   u64 offset of 'X', "GCIX"
+//
+// Frames only cost the cells that changed, and a keyframe at least every
+// interval bounds how far a seek has to decode from its index entry.
+// Spans of changes less than MERGE_GAP cells apart are stored as one, since
+// a couple of unchanged bytes cost less than another span header.
+const char CAST_MAGIC[4] = { 'G', 'C', 'S', 'T' };
+const char CAST_INDEX_MAGIC[4] = { 'G', 'C', 'I', 'X' };
+const uint8_t CAST_VERSION = 1;
+const int DEFAULT_KEYFRAME_MS = 1000;
+const int MERGE_GAP = 3;
+
+// Largest frame a recording holds, in cells: a 4096x4096 world shown whole.
+// The encoder skips bigger frames and the reader rejects files that claim
+// them, so a corrupt header can't make it allocate gigabytes.
+const unsigned long long MAX_CAST_CELLS = 4096ULL * 4096;
+
+// Turns a stream of frames into records. Each frame is diffed against the
+// previous one it was given; a size change forces a keyframe.
+class CastEncoder {
+private:
+    ostream& out;
+    uint64_t offset;
+    int keyframeMs;
+
+    vector<string> rows;
+    vector<string> lines;
+    int width, height;
+    int64_t lastMs;
+    int64_t lastKeyMs;
+    bool started;
+    bool finished;
+
+    vector<uint8_t> changed;
+    vector<int> spans;              // start, end pairs
+    vector<uint64_t> keyOffsets;
+    vector<int64_t> keyTimes;
+    string record;
+    long long frames;
+    long long keyframes;
+
+    void putByte(uint8_t value) { record.push_back((char)value); }
+
+    void putVarint(unsigned long long value) {
+        while (value >= 0x80) {
+            putByte((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        putByte((uint8_t)value);
+    }
+
+    void putFixed(uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) putByte((uint8_t)(value >> (8 * i)));
+    }
+
+    // Written with the first record, so the output stream may be opened
+    // after the encoder is built.
+    void writeHeader() {
+        record.append(CAST_MAGIC, 4);
+        putByte(CAST_VERSION);
+        putVarint(keyframeMs);
+        flushRecord();
+    }
+
+    void flushRecord() {
+        out.write(record.data(), record.size());
+        offset += record.size();
+        record.clear();
+    }
+
+    void encodeKeyframe(const vector<string>& frameRows, const vector<string>& frameLines, int64_t timeMs) {
+        keyOffsets.push_back(offset);
+        keyTimes.push_back(timeMs);
+        lastKeyMs = timeMs;
+        keyframes++;
+
+        putByte('K');
+        putVarint((unsigned long long)timeMs);
+        putVarint(width);
+        putVarint(height);
+
+        char current = 0;
+        unsigned long long run = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                char c = frameRows[y][x];
+                if (run > 0 && c == current) {
+                    run++;
+                    continue;
+                }
+                if (run > 0) {
+                    putVarint(run);
+                    putByte((uint8_t)current);
+                }
+                current = c;
+                run = 1;
+            }
+        }
+        if (run > 0) {
+            putVarint(run);
+            putByte((uint8_t)current);
+        }
+
+        putVarint(frameLines.size());
+        for (size_t i = 0; i < frameLines.size(); i++) {
+            putVarint(frameLines[i].size());
+            record += frameLines[i];
+        }
+    }
+
+    void encodeDelta(const vector<string>& frameRows, const vector<string>& frameLines, int64_t timeMs) {
+        putByte('D');
+        putVarint((unsigned long long)(timeMs - lastMs));
+
+        // Cells are compared in row-major order as one long run, so a change
+        // that wraps onto the next row is still a single span.
+        changed.resize(width * height);
+        int cells = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) changed[cells++] = frameRows[y][x] != rows[y][x];
+        }
+
+        spans.clear();
+        int i = 0;
+        while (i < cells) {
+            if (!changed[i]) {
+                i++;
+                continue;
+            }
+            int end = i + 1;
+            int gap = 0;
+            while (end + gap < cells && gap < MERGE_GAP) {
+                if (changed[end + gap]) {
+                    end += gap + 1;
+                    gap = 0;
+                } else {
+                    gap++;
+                }
+            }
+
+            spans.push_back(i);
+            spans.push_back(end);
+            i = end;
+        }
+
+        // Most spans are a cell or two (a bullet leaving one cell and
+        // entering another), so the length shares a varint with the skip.
+        putVarint(spans.size() / 2);
+        int done = 0;
+        for (size_t s = 0; s < spans.size(); s += 2) {
+            int start = spans[s], length = spans[s + 1] - start;
+            putVarint((unsigned long long)(start - done) << 2 | (unsigned long long)min(length - 1, 3));
+            if (length >= 4) putVarint((unsigned long long)(length - 4));
+            for (int c = start; c < start + length; c++) putByte((uint8_t)frameRows[c / width][c % width]);
+            done = start + length;
+        }
+
+        uint64_t mask = 0;
+        for (size_t l = 0; l < frameLines.size() && l < 64; l++) {
+            if (l >= lines.size() || lines[l] != frameLines[l]) mask |= 1ULL << l;
+        }
+        putVarint(frameLines.size());
+        putVarint(mask);
+        for (size_t l = 0; l < frameLines.size(); l++) {
+            if (l < 64 && !(mask & (1ULL << l))) continue;
+            putVarint(frameLines[l].size());
+            record += frameLines[l];
+        }
+    }
+
+public:
+    explicit CastEncoder(ostream& out, int keyframeMs = DEFAULT_KEYFRAME_MS) :
+        out(out), offset(0), keyframeMs(max(keyframeMs, 1)), width(0), height(0),
+        lastMs(0), lastKeyMs(0), started(false), finished(false), frames(0), keyframes(0) {
+        record.reserve(8192);
+    }
+
+    // Times must not go backwards.
+    void encode(const vector<string>& frameRows, const vector<string>& frameLines, int64_t timeMs) {
+        if (frameRows.empty() || finished) return;
+        if ((unsigned long long)frameRows[0].size() * frameRows.size() > MAX_CAST_CELLS) return;
+        if (offset == 0) writeHeader();
+        timeMs = max(timeMs, lastMs);
+        int frameWidth = (int)frameRows[0].size();
+        int frameHeight = (int)frameRows.size();
+
+        if (!started || frameWidth != width || frameHeight != height || timeMs - lastKeyMs >= keyframeMs) {
+            width = frameWidth;
+            height = frameHeight;
+            encodeKeyframe(frameRows, frameLines, timeMs);
+            started = true;
+        } else {
+            encodeDelta(frameRows, frameLines, timeMs);
+        }
+        flushRecord();
+
+        rows.resize(height);
+        for (int y = 0; y < height; y++) rows[y] = frameRows[y];
+        lines.resize(frameLines.size());
+        for (size_t l = 0; l < frameLines.size(); l++) lines[l] = frameLines[l];
+        lastMs = timeMs;
+        frames++;
+    }
+
+    // Ends the session at `endMs` and writes the seek index.
+    void finish(int64_t endMs) {
+        if (finished) return;
+        finished = true;
+        if (offset == 0) writeHeader();
+        endMs = max(endMs, lastMs);
+        putByte('E');
+        putVarint((unsigned long long)(endMs - lastMs));
+        flushRecord();
+
+        uint64_t indexOffset = offset;
+        uint32_t seconds = keyTimes.empty() ? 0 : (uint32_t)(endMs / 1000 + 1);
+        putByte('X');
+        putFixed(seconds, 4);
+        size_t key = 0;
+        for (uint32_t s = 0; s < seconds; s++) {
+            while (key + 1 < keyTimes.size() && keyTimes[key + 1] <= (int64_t)s * 1000) key++;
+            putFixed(keyOffsets[key], 8);
+        }
+        putFixed(indexOffset, 8);
+        record.append(CAST_INDEX_MAGIC, 4);
+        flushRecord();
+        out.flush();
+    }
+
+    long long frameCount() const { return frames; }
+    long long keyframeCount() const { return keyframes; }
+    uint64_t bytesWritten() const { return offset; }
+};
+
+// One captured frame. Only the first lineCount footer lines are live, and
+// copying a frame over another keeps the target's line slots. The slots
+// start out with the same room as the renderer's footer, so the game over
+// lines turning up late don't make every queue slot allocate.
+struct CastFrame {
+    enum { LINES_RESERVE = 8, LINE_RESERVE = 2 * WIDTH };
+
+    vector<string> rows;
+    vector<string> lines;
+    size_t lineCount;
+    int64_t timeMs;
+
+    CastFrame() : lines(LINES_RESERVE), lineCount(0), timeMs(0) {
+        for (size_t i = 0; i < lines.size(); i++) lines[i].reserve(LINE_RESERVE);
+    }
+    CastFrame(const CastFrame& other) = default;
+
+    CastFrame& operator=(const CastFrame& other) {
+        if (this == &other) return *this;
+        rows.resize(other.rows.size());
+        for (size_t y = 0; y < rows.size(); y++) rows[y] = other.rows[y];
+        if (lines.size() < other.lineCount) lines.resize(other.lineCount);
+        for (size_t i = 0; i < other.lineCount; i++) lines[i] = other.lines[i];
+        lineCount = other.lineCount;
+        timeMs = other.timeMs;
+        return *this;
+    }
+};
+
+// Records frames on its own thread. capture() only copies the composed
+// frame into a queue slot (the strings are assigned in place, so once warm
+// it doesn't allocate); diffing, encoding and file writes all happen on
+// the worker. A full queue drops the frame rather than stall the game,
+// and the next frame is simply diffed against the last one encoded.
+class SessionRecorder {
+private:
+    static const int QUEUE_SLOTS = 32;
+
+    ofstream file;
+    CastEncoder encoder;
+    SpscQueue<CastFrame, QUEUE_SLOTS> queue;
+    CastFrame staging;
+    CastFrame working;
+    atomic<bool> running;
+    thread worker;
+
+    chrono::steady_clock::time_point started;
+
+    // Game thread.
+    bool lossless;
+    long long captured;
+    long long dropped;
+    double captureSumNs;
+    int64_t lastCaptureMs;
+
+    void drain() {
+        while (queue.pop(working)) {
+            working.lines.resize(working.lineCount);
+            encoder.encode(working.rows, working.lines, working.timeMs);
+        }
+    }
+
+    void writeLoop() {
+        while (running.load(memory_order_acquire)) {
+            drain();
+            this_thread::sleep_for(chrono::milliseconds(2));
+        }
+        drain();
+    }
+
+public:
+    explicit SessionRecorder(int keyframeMs = DEFAULT_KEYFRAME_MS) :
+        encoder(file, keyframeMs), running(false), started(chrono::steady_clock::now()),
+        lossless(false), captured(0), dropped(0), captureSumNs(0), lastCaptureMs(0) {}
+
+    ~SessionRecorder() { stop(lastCaptureMs); }
+
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+    // Starts the worker and the session clock.
+    bool open(const string& path) {
+        if (worker.joinable()) return false;
+        file.open(path.c_str(), ios::binary);
+        if (!file.is_open()) return false;
+        started = chrono::steady_clock::now();
+        running.store(true);
+        worker = thread(&SessionRecorder::writeLoop, this);
+        return true;
+    }
+
+    // Waits for the worker instead of dropping frames, for runs that go
+    // faster than real time and have nobody to stall.
+    void setLossless(bool wait) { lossless = wait; }
+
+    void capture(const ConsoleRenderer& renderer, int64_t timeMs) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        renderer.saveFrame(staging.rows, staging.lines, staging.lineCount);
+        staging.timeMs = timeMs;
+        while (lossless && !queue.push(staging)) this_thread::yield();
+        if (lossless || queue.push(staging)) {
+            captured++;
+        } else {
+            dropped++;
+        }
+        lastCaptureMs = timeMs;
+        captureSumNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    }
+
+    // Stamped with the wall clock since the recorder was created.
+    void capture(const ConsoleRenderer& renderer) { capture(renderer, elapsedMs()); }
+
+    int64_t elapsedMs() const {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+    }
+
+    // Encodes whatever is still queued and writes the index. The session
+    // ends at `endMs`.
+    void stop(int64_t endMs) {
+        if (!worker.joinable()) return;
+        running.store(false, memory_order_release);
+        worker.join();
+        encoder.finish(endMs);
+    }
+
+    long long capturedFrames() const { return captured; }
+    long long droppedFrames() const { return dropped; }
+    double meanCaptureUs() const { return captured + dropped ? captureSumNs / (captured + dropped) / 1000 : 0; }
+
+    // Only meaningful after stop().
+    long long keyframeCount() const { return encoder.keyframeCount(); }
+    uint64_t bytesWritten() const { return encoder.bytesWritten(); }
+};
+
+// Loads a whole recording into memory and decodes it frame by frame. The
+// current frame is always complete, so it can go straight to a
+// ConsoleRenderer.
+class CastReader {
+private:
+    vector<uint8_t> data;
+    size_t pos;
+    size_t recordsEnd;          // where the index starts
+    vector<uint64_t> index;
+    int keyframeMs;
+
+    vector<string> rows;
+    vector<string> lines;
+    int width, height;
+    int64_t timeMs;
+    int64_t endMs;
+    bool keyframe;
+    bool ok;
+
+    uint8_t byte() {
+        if (pos >= recordsEnd) {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    unsigned long long varint() {
+        unsigned long long value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= (unsigned long long)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    uint64_t fixedAt(size_t at, int bytes) const {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) value |= (uint64_t)data[at + i] << (8 * i);
+        return value;
+    }
+
+    void readBytes(string& out, size_t length) {
+        if (length > recordsEnd - pos) {
+            ok = false;
+            return;
+        }
+        out.assign((const char*)&data[pos], length);
+        pos += length;
+    }
+
+    void readKeyframe() {
+        timeMs = (int64_t)varint();
+        unsigned long long w = varint();
+        unsigned long long h = varint();
+        if (!ok || w == 0 || h == 0 || w > MAX_CAST_CELLS || h > MAX_CAST_CELLS || w * h > MAX_CAST_CELLS) {
+            ok = false;
+            return;
+        }
+        if ((int)w != width || (int)h != height) {
+            width = (int)w;
+            height = (int)h;
+            rows.assign(height, string(width, ' '));
+        }
+
+        unsigned long long cells = w * h;
+        unsigned long long cell = 0;
+        while (cell < cells && ok) {
+            unsigned long long run = varint();
+            char c = (char)byte();
+            if (run > cells - cell) {
+                ok = false;
+                return;
+            }
+            for (unsigned long long i = 0; i < run; i++, cell++) rows[cell / width][cell % width] = c;
+        }
+
+        size_t count = (size_t)varint();
+        if (count > recordsEnd - pos) {
+            ok = false;
+            return;
+        }
+        lines.resize(count);
+        for (size_t l = 0; l < count && ok; l++) readBytes(lines[l], (size_t)varint());
+    }
+
+    void readDelta() {
+        timeMs += (int64_t)varint();
+        unsigned long long cells = (unsigned long long)width * height;
+        unsigned long long cell = 0;
+        unsigned long long spanCount = varint();
+        for (unsigned long long s = 0; s < spanCount && ok; s++) {
+            unsigned long long header = varint();
+            unsigned long long length = (header & 3) + 1;
+            if (length == 4) length += varint();
+            cell += header >> 2;
+            if (!ok || cell > cells || length > cells - cell) {
+                ok = false;
+                return;
+            }
+            for (unsigned long long i = 0; i < length; i++, cell++) rows[cell / width][cell % width] = (char)byte();
+        }
+
+        // Only changed lines cost bytes, and the first 64 may all be unchanged.
+        size_t count = (size_t)varint();
+        uint64_t mask = varint();
+        if (count > 64 + (recordsEnd - pos)) {
+            ok = false;
+            return;
+        }
+        lines.resize(count);
+        for (size_t l = 0; l < count && ok; l++) {
+            if (l < 64 && !(mask & (1ULL << l))) continue;
+            readBytes(lines[l], (size_t)varint());
+        }
+    }
+
+public:
+    CastReader() : pos(0), recordsEnd(0), keyframeMs(DEFAULT_KEYFRAME_MS), width(0), height(0),
+                   timeMs(0), endMs(0), keyframe(false), ok(false) {}
+
+    bool load(const string& path, string& error) {
+        ifstream in(path.c_str(), ios::binary);
+        if (!in) {
+            error = "cannot open " + path;
+            return false;
+        }
+        data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+
+        if (data.size() < 5 + 12 || memcmp(data.data(), CAST_MAGIC, 4) != 0) {
+            error = path + " is not a session recording";
+            return false;
+        }
+        if (data[4] != CAST_VERSION) {
+            error = path + " was written by a different version";
+            return false;
+        }
+        if (memcmp(&data[data.size() - 4], CAST_INDEX_MAGIC, 4) != 0) {
+            error = path + " has no index (was the recording cut short?)";
+            return false;
+        }
+
+        uint64_t indexOffset = fixedAt(data.size() - 12, 8);
+        if (indexOffset + 5 > data.size() - 12 || data[indexOffset] != 'X') {
+            error = path + " has a damaged index";
+            return false;
+        }
+        uint32_t seconds = (uint32_t)fixedAt(indexOffset + 1, 4);
+        if (indexOffset + 5 + (uint64_t)seconds * 8 != data.size() - 12) {
+            error = path + " has a damaged index";
+            return false;
+        }
+        index.resize(seconds);
+        for (uint32_t s = 0; s < seconds; s++) {
+            index[s] = fixedAt(indexOffset + 5 + s * 8, 8);
+            if (index[s] >= indexOffset) {
+                error = path + " has a damaged index";
+                return false;
+            }
+        }
+        recordsEnd = (size_t)indexOffset;
+
+        pos = 5;
+        ok = true;
+        keyframeMs = (int)varint();
+
+        // Walking every record once validates them all and finds the end
+        // record, which holds the session length.
+        size_t first = pos;
+        while (next()) {}
+        if (ok && byte() == 'E') endMs = timeMs + (int64_t)varint();
+        if (!ok) {
+            error = path + " is damaged";
+            return false;
+        }
+        pos = first;
+        timeMs = 0;
+        width = height = 0;
+        rows.clear();
+        lines.clear();
+        return next();
+    }
+
+    // Decodes the next frame. False at the end of the session (or on a
+    // damaged record, see good()).
+    bool next() {
+        if (!ok || pos >= recordsEnd) return false;
+        size_t start = pos;
+        uint8_t type = byte();
+        keyframe = type == 'K';
+        if (type == 'K') {
+            readKeyframe();
+        } else if (type == 'D' && width > 0) {
+            readDelta();
+        } else if (type == 'E') {
+            pos = start;                // stay on the end record
+            return false;
+        } else {
+            ok = false;
+        }
+        return ok;
+    }
+
+    // Time of the frame after the current one, or -1 at the end.
+    int64_t peekTime() {
+        if (!ok || pos >= recordsEnd) return -1;
+        size_t saved = pos;
+        uint8_t type = byte();
+        int64_t t = -1;
+        if (type == 'K') t = (int64_t)varint();
+        else if (type == 'D') t = timeMs + (int64_t)varint();
+        pos = saved;
+        return t;
+    }
+
+    // Jumps to the last frame at or before `targetMs`: one index lookup,
+    // then at most a keyframe interval of deltas.
+    void seek(int64_t targetMs) {
+        if (index.empty()) return;
+        targetMs = max<int64_t>(0, min(targetMs, endMs));
+        size_t second = min((size_t)(targetMs / 1000), index.size() - 1);
+        pos = (size_t)index[second];
+        ok = true;
+        width = height = 0;
+        next();
+        for (;;) {
+            int64_t t = peekTime();
+            if (t < 0 || t > targetMs) break;
+            next();
+        }
+    }
+
+    bool good() const { return ok; }
+    bool isKeyframe() const { return keyframe; }
+    int64_t currentMs() const { return timeMs; }
+    int64_t durationMs() const { return endMs; }
+    int getKeyframeMs() const { return keyframeMs; }
+    size_t fileBytes() const { return data.size(); }
+    size_t indexSeconds() const { return index.size(); }
+    const vector<string>& frameRows() const { return rows; }
+    const vector<string>& frameLines() const { return lines; }
+};
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "rng.h"
+#include "bullet_store.h"
+#include "entity_store.h"
+
+using namespace std;
+
+// Running totals for balance testing. They never feed back into the
+// simulation, but they rewind with it.
+struct GameStats {
+    int32_t kills[ENEMY_KIND_COUNT];
+    int32_t hitsTaken[BULLET_KIND_COUNT];
+};
+
+// Every scalar that influences the next tick, as one plain block that can
+// be copied with memcpy. Entity lanes are too big to live here; a Snapshot
+// packs them behind it.
+struct GameState {
+    Rng rng;
+    int32_t playerX;
+    int32_t score;
+    int32_t lives;
+    int32_t wave;
+    int32_t titleSelection;
+    int32_t frameCount;
+    int32_t shootCooldown;
+    int32_t mechanicsDisplayTime;
+    int32_t giantBossDefeatTimer;
+    int32_t bossWarningTime;
+    int32_t partnerX;
+    int32_t partnerCooldown;
+    uint8_t coop;
+    uint8_t gameOver;
+    uint8_t showTitleScreen;
+    uint8_t showMechanics;
+    uint8_t giantBossSpawnedThisWave;
+    uint8_t leftPressed, rightPressed, spacePressed;
+    uint8_t upPressed, downPressed, enterPressed;
+    GameStats stats;
+};
+
+static_assert(is_trivially_copyable<GameState>::value, "GameState must be memcpy-able");
+
+// A saved game: the state block, the live length of every lane, and the
+// lanes' live elements packed back to back in one byte buffer. The buffer
+// only grows, so once a snapshot has seen the biggest field it will hold,
+// saving into it again never allocates.
+struct Snapshot {
+    GameState state;
+    uint32_t bulletCounts[BULLET_KIND_COUNT];
+    uint32_t enemyCounts[ENEMY_KIND_COUNT];
+    uint32_t enemySlotCount;
+    uint32_t enemyFreeSlot;
+    vector<uint8_t> data;
+    size_t used;
+
+    Snapshot() : enemySlotCount(0), enemyFreeSlot(EnemySlotTable::NONE), used(0) {}
+
+    size_t bytes() const { return sizeof(GameState) + used; }
+};
+
+// Packs lanes into a Snapshot's buffer.
+class SnapshotWriter {
+private:
+    Snapshot& snapshot;
+
+public:
+    explicit SnapshotWriter(Snapshot& snapshot) : snapshot(snapshot) { snapshot.used = 0; }
+
+    template <typename T>
+    void put(const vector<T>& values, size_t count) {
+        size_t size = count * sizeof(T);
+        if (snapshot.used + size > snapshot.data.size()) {
+            snapshot.data.resize((snapshot.used + size) * 2);
+        }
+        if (size > 0) memcpy(snapshot.data.data() + snapshot.used, values.data(), size);
+        snapshot.used += size;
+    }
+
+    void put(const BulletLane& lane) {
+        size_t n = lane.size();
+        put(lane.x, n);
+        put(lane.y, n);
+        put(lane.movePhase, n);
+        put(lane.active, n);
+        if (lane.hasVelocity) {
+            put(lane.vx, n);
+            put(lane.vy, n);
+            put(lane.fracX, n);
+            put(lane.fracY, n);
+        }
+    }
+
+    void put(const EnemyLane& lane) {
+        size_t n = lane.size();
+        put(lane.x, n);
+        put(lane.y, n);
+        put(lane.health, n);
+        put(lane.direction, n);
+        put(lane.movePhase, n);
+        put(lane.shootCooldown, n);
+        put(lane.patternCounter, n);
+        put(lane.alive, n);
+        put(lane.slot, n);
+    }
+
+    void put(const EnemySlotTable& table) {
+        size_t n = table.size();
+        snapshot.enemySlotCount = (uint32_t)n;
+        snapshot.enemyFreeSlot = table.freeHead;
+        put(table.generation, n);
+        put(table.index, n);
+        put(table.kind, n);
+    }
+};
+
+// Unpacks lanes in the order SnapshotWriter packed them. Lanes keep their
+// capacity across restores, so this only allocates if the snapshot holds
+// more entities than the lane has ever had room for.
+class SnapshotReader {
+private:
+    const Snapshot& snapshot;
+    size_t offset;
+
+public:
+    explicit SnapshotReader(const Snapshot& snapshot) : snapshot(snapshot), offset(0) {}
+
+    template <typename T>
+    void take(vector<T>& values, size_t count) {
+        size_t size = count * sizeof(T);
+        if (size > 0) memcpy(values.data(), snapshot.data.data() + offset, size);
+        offset += size;
+    }
+
+    void take(BulletLane& lane, size_t n) {
+        if (n > lane.capacity) lane.reserve(n, lane.hasVelocity);
+        take(lane.x, n);
+        take(lane.y, n);
+        take(lane.movePhase, n);
+        take(lane.active, n);
+        if (lane.hasVelocity) {
+            take(lane.vx, n);
+            take(lane.vy, n);
+            take(lane.fracX, n);
+            take(lane.fracY, n);
+        }
+        lane.count = n;
+    }
+
+    void take(EnemyLane& lane, size_t n) {
+        lane.resize(n);
+        take(lane.x, n);
+        take(lane.y, n);
+        take(lane.health, n);
+        take(lane.direction, n);
+        take(lane.movePhase, n);
+        take(lane.shootCooldown, n);
+        take(lane.patternCounter, n);
+        take(lane.alive, n);
+        take(lane.slot, n);
+    }
+
+    void take(EnemySlotTable& table) {
+        size_t n = snapshot.enemySlotCount;
+        table.generation.resize(n);
+        table.index.resize(n);
+        table.kind.resize(n);
+        take(table.generation, n);
+        take(table.index, n);
+        take(table.kind, n);
+        table.freeHead = snapshot.enemyFreeSlot;
+    }
+};
+
+// The last `capacity` snapshots, oldest overwritten first. All slots are
+// allocated up front; back(0) is the newest.
+class SnapshotRing {
+private:
+    vector<Snapshot> slots;
+    size_t head;
+    size_t count;
+
+public:
+    explicit SnapshotRing(size_t capacity, size_t bytesPerSlot = 64 * 1024) :
+        slots(capacity ? capacity : 1), head(0), count(0) {
+        for (size_t i = 0; i < slots.size(); i++) slots[i].data.resize(bytesPerSlot);
+    }
+
+    size_t capacity() const { return slots.size(); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // The slot to save the next snapshot into.
+    Snapshot& push() {
+        Snapshot& slot = slots[head];
+        head = (head + 1) % slots.size();
+        if (count < slots.size()) count++;
+        return slot;
+    }
+
+    const Snapshot& back(size_t age = 0) const {
+        return slots[(head + slots.size() - 1 - age) % slots.size()];
+    }
+
+    // Forgets the `age` newest snapshots, so back() becomes the one that
+    // was back(age). Used to rewind before resimulating.
+    void discard(size_t age) {
+        if (age > count) age = count;
+        head = (head + slots.size() - age) % slots.size();
+        count -= age;
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+};
+
+#endif
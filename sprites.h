@@ -0,0 +1,148 @@
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+enum SpriteId {
+    SPRITE_PLAYER,
+    SPRITE_REGULAR,
+    SPRITE_BOSS,
+    SPRITE_GIANT_BOSS,
+    SPRITE_PARTNER,
+    SPRITE_COUNT
+};
+
+// Source art. Spaces are transparent; (originX, originY) is the cell that
+// lands on the entity's position.
+struct SpriteArt {
+    int originX, originY;
+    int height;
+    const char* rows[8];
+};
+
+const SpriteArt SPRITE_ART[SPRITE_COUNT] = {
+    { 1, 0, 1, { "<A>" } },
+    { 1, 0, 1, { "-E-" } },
+    { 1, 0, 1, { "[B]" } },
+    { 3, 0, 5, { "   ^   ",
+                 "  /|\\  ",
+                 " [=O=] ",
+                 "<==V==>",
+                 " ||||| " } },
+    { 1, 0, 1, { "{A}" } }
+};
+
+// A run of opaque cells in one sprite row, at (x, y) from the sprite's
+// top-left corner. `glyph` indexes the atlas's glyph buffer, where the
+// run's characters sit back to back.
+struct SpriteSpan {
+    int16_t x, y;
+    int16_t length;
+    int32_t glyph;
+};
+
+struct Sprite {
+    int width, height;
+    int originX, originY;
+    int firstSpan, spanCount;
+    int firstMask;
+};
+
+// Everything needed to draw one sprite, as raw pointers into the atlas.
+// Callers drawing many copies fetch it once and keep it in a local, where
+// the compiler can hold it in registers across the character stores.
+struct SpriteView {
+    int width, height;
+    int originX, originY;
+    const SpriteSpan* spans;
+    int spanCount;
+    const char* glyphs;
+    const uint64_t* masks;
+};
+
+// All sprites compiled once into flat arrays of opaque spans, so drawing a
+// sprite is one clip test and one short copy per span instead of a bounds
+// check per character. Each sprite row is also compiled into a collision
+// mask, bit i set when column i is opaque, so hit tests match exactly what
+// is drawn. Sprites are at most 64 columns wide.
+class SpriteAtlas {
+private:
+    Sprite sprites[SPRITE_COUNT];
+    vector<SpriteSpan> spans;
+    vector<char> glyphs;
+    vector<uint64_t> masks;
+
+public:
+    SpriteAtlas() {
+        for (int id = 0; id < SPRITE_COUNT; id++) {
+            const SpriteArt& art = SPRITE_ART[id];
+            Sprite& sprite = sprites[id];
+            sprite.width = 0;
+            sprite.height = art.height;
+            sprite.originX = art.originX;
+            sprite.originY = art.originY;
+            sprite.firstSpan = (int)spans.size();
+            sprite.firstMask = (int)masks.size();
+
+            for (int r = 0; r < art.height; r++) {
+                const char* row = art.rows[r];
+                int length = (int)strlen(row);
+                if (length > sprite.width) sprite.width = length;
+
+                uint64_t mask = 0;
+                for (int x = 0; x < length && x < 64; x++) {
+                    if (row[x] != ' ') mask |= 1ULL << x;
+                }
+                masks.push_back(mask);
+
+                int x = 0;
+                while (x < length) {
+                    if (row[x] == ' ') {
+                        x++;
+                        continue;
+                    }
+                    SpriteSpan span;
+                    span.x = (int16_t)x;
+                    span.y = (int16_t)r;
+                    span.glyph = (int32_t)glyphs.size();
+                    while (x < length && row[x] != ' ') glyphs.push_back(row[x++]);
+                    span.length = (int16_t)(glyphs.size() - span.glyph);
+                    spans.push_back(span);
+                }
+            }
+            sprite.spanCount = (int)spans.size() - sprite.firstSpan;
+        }
+    }
+
+    const Sprite& sprite(int id) const { return sprites[id]; }
+
+    SpriteView view(int id) const {
+        const Sprite& s = sprites[id];
+        SpriteView v = { s.width, s.height, s.originX, s.originY,
+                         spans.data() + s.firstSpan, s.spanCount, glyphs.data(),
+                         masks.data() + s.firstMask };
+        return v;
+    }
+
+    // Whether the sprite drawn at an entity's position covers the cell
+    // (dx, dy) away from it.
+    bool covers(int id, int dx, int dy) const {
+        const Sprite& s = sprites[id];
+        int column = dx + s.originX;
+        int row = dy + s.originY;
+        if ((unsigned)column >= (unsigned)s.width || (unsigned)row >= (unsigned)s.height) return false;
+        return (masks[s.firstMask + row] >> column) & 1;
+    }
+};
+
+// The atlas is immutable after construction, so every game shares one.
+inline const SpriteAtlas& spriteAtlas() {
+    static const SpriteAtlas atlas;
+    return atlas;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// Bounded single-producer single-consumer ring. One thread may push and one
+// other thread may pop, without locks: each side owns one index and only
+// reads the other's. Capacity must be a power of two; one slot stays empty
+// to tell full from empty.
+template <typename T, size_t Capacity>
+class SpscQueue {
+private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    T slots[Capacity];
+    // Kept on separate cache lines so the two threads don't fight over them.
+    alignas(64) atomic<size_t> head;    // next slot to pop, written by the consumer
+    alignas(64) atomic<size_t> tail;    // next slot to push, written by the producer
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer side. Returns false (and drops the value) when full.
+    bool push(const T& value) {
+        size_t t = tail.load(memory_order_relaxed);
+        size_t next = (t + 1) & (Capacity - 1);
+        if (next == head.load(memory_order_acquire)) return false;
+        slots[t] = value;
+        tail.store(next, memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T& value) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) return false;
+        value = slots[h];
+        head.store((h + 1) & (Capacity - 1), memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(memory_order_acquire) == tail.load(memory_order_acquire);
+    }
+};
+
+#endif
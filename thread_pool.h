@@ -0,0 +1,119 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+// Fixed set of workers, each with its own task deque. A worker takes from
+// the back of its own deque and, when that runs dry, steals from the front
+// of the others', so one long task never leaves the rest of the cores idle.
+class WorkStealingPool {
+private:
+    struct Queue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<thread> workers;
+    vector<Queue*> queues;
+    atomic<size_t> nextQueue;
+    atomic<long long> queued;
+    atomic<long long> pending;
+    atomic<bool> stopping;
+    mutex sleepLock;
+    condition_variable wake;
+    condition_variable idle;
+
+    bool popLocal(size_t self, function<void()>& task) {
+        Queue& q = *queues[self];
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty()) return false;
+        task = move(q.tasks.back());
+        q.tasks.pop_back();
+        queued.fetch_sub(1);
+        return true;
+    }
+
+    bool steal(size_t self, function<void()>& task) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue& q = *queues[(self + i) % queues.size()];
+            lock_guard<mutex> guard(q.lock);
+            if (q.tasks.empty()) continue;
+            task = move(q.tasks.front());
+            q.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self) {
+        function<void()> task;
+        while (true) {
+            if (popLocal(self, task) || steal(self, task)) {
+                task();
+                task = nullptr;
+                if (pending.fetch_sub(1) == 1) {
+                    lock_guard<mutex> guard(sleepLock);
+                    idle.notify_all();
+                }
+                continue;
+            }
+
+            unique_lock<mutex> guard(sleepLock);
+            if (stopping) return;
+            if (queued.load() > 0) continue;
+            wake.wait(guard);
+        }
+    }
+
+public:
+    explicit WorkStealingPool(size_t threadCount = 0) : nextQueue(0), queued(0), pending(0), stopping(false) {
+        if (threadCount == 0) threadCount = thread::hardware_concurrency();
+        if (threadCount == 0) threadCount = 1;
+        for (size_t i = 0; i < threadCount; i++) queues.push_back(new Queue());
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.push_back(thread(&WorkStealingPool::workerLoop, this, i));
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> guard(sleepLock);
+            stopping = true;
+            wake.notify_all();
+        }
+        for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+        for (size_t i = 0; i < queues.size(); i++) delete queues[i];
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // Tasks are dealt round-robin; stealing evens out whatever that misses.
+    void submit(function<void()> task) {
+        pending.fetch_add(1);
+        queued.fetch_add(1);
+        Queue& q = *queues[nextQueue.fetch_add(1) % queues.size()];
+        {
+            lock_guard<mutex> guard(q.lock);
+            q.tasks.push_back(move(task));
+        }
+        lock_guard<mutex> guard(sleepLock);
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task has finished.
+    void wait() {
+        unique_lock<mutex> guard(sleepLock);
+        while (pending.load() > 0) idle.wait(guard);
+    }
+};
+
+#endif
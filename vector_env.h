@@ -0,0 +1,155 @@
+#ifndef VECTOR_ENV_H
+#define VECTOR_ENV_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "game.h"
+#include "thread_pool.h"
+#include "galaga_env.h"
+
+using namespace std;
+
+const unsigned ENV_ACTION_KEYS[GALAGA_ACTION_COUNT] = {
+    0,
+    INPUT_LEFT,
+    INPUT_RIGHT,
+    INPUT_SPACE,
+    INPUT_LEFT | INPUT_SPACE,
+    INPUT_RIGHT | INPUT_SPACE
+};
+
+// N independent headless games stepped together, behind galaga_env.h.
+// Games never share state, so each worker steps a contiguous range of
+// them and writes only that range of the caller's buffers.
+class VectorEnv {
+private:
+    vector<ResponsiveGame> games;
+    vector<uint64_t> seeds;
+    vector<int> lastScore;
+    WorkStealingPool* pool;
+    size_t workers;
+    size_t chunks;
+
+    bool resetting;
+    uint64_t resetSeed;
+    const int32_t* actions;
+    uint8_t* observations;
+    float* rewards;
+    uint8_t* dones;
+
+    void observe(size_t i) {
+        ResponsiveGame& game = games[i];
+        game.composeField();
+
+        uint8_t* record = observations + i * GALAGA_ENV_OBSERVATION_BYTES;
+        const ConsoleRenderer& renderer = game.getRenderer();
+        for (int y = 0; y < GALAGA_ENV_GRID_HEIGHT; y++) {
+            memcpy(record + y * GALAGA_ENV_GRID_WIDTH, renderer.row(y).data(), GALAGA_ENV_GRID_WIDTH);
+        }
+
+        float features[GALAGA_ENV_FEATURE_COUNT];
+        features[GALAGA_FEATURE_PLAYER_X] = (float)game.getPlayerX();
+        features[GALAGA_FEATURE_LIVES] = (float)game.getLives();
+        features[GALAGA_FEATURE_WAVE] = (float)game.getWave();
+        features[GALAGA_FEATURE_SCORE] = (float)game.getScore();
+        features[GALAGA_FEATURE_ENEMIES_ALIVE] = (float)game.getAliveEnemyCount();
+        features[GALAGA_FEATURE_BOSSES_ALIVE] = (float)game.getAliveBossCount();
+        features[GALAGA_FEATURE_GIANT_BOSS_HEALTH] = (float)max(game.getGiantBossHealth(), 0);
+        features[GALAGA_FEATURE_TICK] = (float)game.getFrameCount();
+        memcpy(record + GALAGA_ENV_FEATURE_OFFSET, features, sizeof(features));
+    }
+
+    void restart(size_t i, uint64_t seed) {
+        seeds[i] = seed;
+        games[i].restart(seed);
+        lastScore[i] = 0;
+    }
+
+    void stepOne(size_t i) {
+        ResponsiveGame& game = games[i];
+        int32_t action = actions[i];
+        game.applyInput(action >= 0 && action < GALAGA_ACTION_COUNT ? ENV_ACTION_KEYS[action] : 0);
+        game.updateGame();
+
+        int score = game.getScore();
+        rewards[i] = (float)(score - lastScore[i]);
+        lastScore[i] = score;
+        dones[i] = game.isGameOver();
+        if (dones[i]) restart(i, seeds[i] + games.size());
+        observe(i);
+    }
+
+    // One worker's share of a reset or step: games [begin, end) of
+    // chunk `c`.
+    void runChunk(size_t c) {
+        size_t begin = games.size() * c / chunks;
+        size_t end = games.size() * (c + 1) / chunks;
+        for (size_t i = begin; i < end; i++) {
+            if (resetting) {
+                restart(i, resetSeed + i);
+                observe(i);
+            } else {
+                stepOne(i);
+            }
+        }
+    }
+
+    // The task captures only `this` and the chunk number, small enough for
+    // std::function to keep inline, so handing work to the pool doesn't
+    // allocate per call.
+    void runAll() {
+        if (!pool) {
+            runChunk(0);
+            return;
+        }
+        for (size_t c = 0; c < chunks; c++) {
+            pool->submit([this, c]() { runChunk(c); });
+        }
+        pool->wait();
+    }
+
+public:
+    VectorEnv(int envCount, int threads) :
+        games(max(envCount, 1)), seeds(games.size(), 0), lastScore(games.size(), 0),
+        pool(nullptr), workers(1), chunks(1), resetting(false), resetSeed(0),
+        actions(nullptr), observations(nullptr), rewards(nullptr), dones(nullptr) {
+        if (threads != 1 && games.size() > 1) {
+            pool = new WorkStealingPool(threads > 0 ? (size_t)threads : 0);
+            workers = pool->size();
+            if (workers < 2) {
+                delete pool;
+                pool = nullptr;
+                workers = 1;
+            }
+        }
+        chunks = min(workers, games.size());
+    }
+
+    ~VectorEnv() { delete pool; }
+
+    VectorEnv(const VectorEnv&) = delete;
+    VectorEnv& operator=(const VectorEnv&) = delete;
+
+    size_t size() const { return games.size(); }
+    size_t threadCount() const { return pool ? workers : 1; }
+    const ResponsiveGame& game(size_t i) const { return games[i]; }
+
+    void reset(uint64_t seed, uint8_t* observationsOut) {
+        observations = observationsOut;
+        resetting = true;
+        resetSeed = seed;
+        runAll();
+    }
+
+    void step(const int32_t* actionsIn, uint8_t* observationsOut, float* rewardsOut, uint8_t* donesOut) {
+        actions = actionsIn;
+        observations = observationsOut;
+        rewards = rewardsOut;
+        dones = donesOut;
+        resetting = false;
+        runAll();
+    }
+};
+
+#endif